@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct BufferedReader
+{
+    int fd;
+    char *buffer;
+    size_t bufferSize;
+    size_t maxBufferSize;
+    size_t dataOffset;
+    size_t dataSize;
+};
+
+
+bool BufferedReader_Initialize(struct BufferedReader *self, int fd, size_t bufferSize
+                               , size_t maxBufferSize);
+void BufferedReader_Finalize(const struct BufferedReader *self);
+ssize_t BufferedReader_Read(struct BufferedReader *self, void *buffer, size_t bufferSize
+                            , int timeout);
+ssize_t BufferedReader_Peek(struct BufferedReader *self, const void **data, size_t dataSize
+                            , int timeout);
+ssize_t BufferedReader_Skip(struct BufferedReader *self, size_t dataSize, int timeout);
+ssize_t BufferedReader_ReadUntil(struct BufferedReader *self, int delimiter, const void **data
+                                 , int timeout);
+ssize_t BufferedReader_ReadLine(struct BufferedReader *self, const void **data, int timeout);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "Reactor.h"
+#include "Semaphore.h"
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct BufferedWriter
+{
+    int fd;
+    char *buffer;
+    size_t bufferSize;
+    size_t bufferUsage;
+    size_t highWaterMark;
+    struct iovec *vector;
+    int vectorLength;
+    int vectorCapacity;
+    int vectorOffset;
+    size_t dataSize;
+    bool isFlushing;
+    int errorNumber;
+    struct Semaphore semaphore;
+    struct ReactorTimeout timeout;
+    struct ReactorWatch watch;
+};
+
+
+bool BufferedWriter_Initialize(struct BufferedWriter *self, int fd, size_t bufferSize
+                               , size_t highWaterMark);
+// Writes whatever the socket accepts without blocking; the rest is dropped.
+void BufferedWriter_Finalize(struct BufferedWriter *self);
+ssize_t BufferedWriter_Write(struct BufferedWriter *self, const void *data, size_t dataSize
+                             , int timeout);
+// `data` must stay valid until BufferedWriter_Flush() returns true or
+// BufferedWriter_Finalize() returns; a failed flush leaves it queued.
+ssize_t BufferedWriter_WriteReference(struct BufferedWriter *self, const void *data
+                                      , size_t dataSize, int timeout);
+bool BufferedWriter_Flush(struct BufferedWriter *self, int timeout);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct DirectReader
+{
+    int fd;
+    bool isDirect;
+    bool isEOF;
+    int errorNumber;
+    size_t chunkSize;
+    int numberOfRequests;
+    int requestIndex;
+    off_t nextOffset;
+    void *requests;
+    void *waiter;
+};
+
+
+bool DirectReader_Initialize(struct DirectReader *self, const char *path, size_t chunkSize
+                             , int numberOfRequests);
+void DirectReader_Finalize(struct DirectReader *self);
+ssize_t DirectReader_Read(struct DirectReader *self, const void **chunk);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
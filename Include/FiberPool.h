@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct FiberPool
+{
+    int minNumberOfFibers;
+    int maxNumberOfFibers;
+    int numberOfFibers;
+    bool isStopped;
+    void *jobList[2];
+    void *idleWorkerList[2];
+    void *busyWorkerList[2];
+    void *finalizer;
+};
+
+
+struct FiberPoolJob
+{
+    void *listItem[2];
+    void (*function)(uintptr_t);
+    uintptr_t argument;
+};
+
+
+bool FiberPool_Initialize(struct FiberPool *self, int minNumberOfFibers, int maxNumberOfFibers);
+bool FiberPool_Finalize(struct FiberPool *self);
+bool FiberPool_PostJob(struct FiberPool *self, struct FiberPoolJob *job
+                       , void (*function)(uintptr_t), uintptr_t argument);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
@@ -9,22 +9,60 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#include <stdbool.h>
+#include <stdint.h>
+
 
 #if defined __cplusplus
 extern "C" {
 #endif
 
 struct iovec;
+struct stat;
+struct mmsghdr;
 struct addrinfo;
 
 
+// Leading byte of every SendConnection() message; peers sharing the socket use other values.
+enum ConnectionTag
+{
+    ConnectionHandoffTag
+};
+
+
+struct RelayOptions
+{
+    int pipeSize;
+    int timeout;
+};
+
+
+struct RelayResult
+{
+    uint64_t numberOfBytes[2];
+    bool isHalfClosed[2];
+    int errorNumber[2];
+};
+
+
+struct FileReadMetrics
+{
+    uint64_t numberOfInlineReads;
+    uint64_t numberOfOffloadedReads;
+};
+
+
 int Pipe2(int *fds, int flags);
 ssize_t Read(int fd, void *buffer, size_t bufferSize, int timeout);
 ssize_t Write(int fd, const void *data, size_t dataSize, int timeout);
 ssize_t ReadV(int fd, const struct iovec *vector, int vectorLength, int timeout);
 ssize_t WriteV(int fd, const struct iovec *vector, int vectorLength, int timeout);
+ssize_t ReadFull(int fd, void *buffer, size_t bufferSize, int timeout);
+ssize_t WriteAll(int fd, const void *data, size_t dataSize, int timeout);
+ssize_t WriteVAll(int fd, struct iovec *vector, int vectorLength, int timeout);
 
 int Socket(int domain, int type, int protocol);
+int SetSocketBusyPoll(int fd, int duration);
 int Accept4(int fd, struct sockaddr *name, socklen_t *nameSize, int flags, int timeout);
 int Connect(int fd, const struct sockaddr *name, socklen_t nameSize, int timeout);
 ssize_t Recv(int fd, void *buffer, size_t bufferSize, int flags, int timeout);
@@ -35,9 +73,32 @@ ssize_t SendTo(int fd, const void *data, size_t dataSize, int flags, const struc
                , socklen_t nameSize, int timeout);
 ssize_t RecvMsg(int fd, struct msghdr *message, int flags, int timeout);
 ssize_t SendMsg(int fd, const struct msghdr *message, int flags, int timeout);
+int RecvMMsg(int fd, struct mmsghdr *vector, unsigned int vectorLength, int flags, int timeout);
+int SendMMsg(int fd, struct mmsghdr *vector, unsigned int vectorLength, int flags, int timeout);
+ssize_t SendConnection(int fd, int connectionFD, const void *data, size_t dataSize, int timeout);
+ssize_t ReceiveConnection(int fd, int *connectionFD, void *buffer, size_t bufferSize, int timeout);
+ssize_t SendFile(int outFD, int inFD, off_t *offset, size_t count, int timeout);
+int Relay(int fd1, int fd2, const struct RelayOptions *options, struct RelayResult *result);
+int SetUDPGRO(int fd, int enabled);
+ssize_t SendSegments(int fd, const void *data, size_t dataSize, size_t segmentSize
+                     , const struct sockaddr *name, socklen_t nameSize, int timeout);
+ssize_t RecvSegments(int fd, void *buffer, size_t bufferSize, size_t *segmentSize
+                     , struct sockaddr *name, socklen_t *nameSize, int timeout);
+int SplitSegments(void *buffer, size_t bufferSize, size_t segmentSize, struct iovec *vector
+                  , int vectorLength);
 
+int RegisterFD(int fd);
 int Close(int fd);
 
+int Open(const char *path, int flags, mode_t mode);
+ssize_t PRead(int fd, void *buffer, size_t bufferSize, off_t offset);
+ssize_t PWrite(int fd, const void *data, size_t dataSize, off_t offset);
+ssize_t PReadV(int fd, const struct iovec *vector, int vectorLength, off_t offset);
+bool GetFileReadMetrics(struct FileReadMetrics *fileReadMetrics);
+int Fsync(int fd);
+int FStat(int fd, struct stat *stat);
+int Unlink(const char *path);
+
 int GetAddrInfo(const char *hostName, const char *serviceName, const struct addrinfo *hints
                 , struct addrinfo **result);
 int GetNameInfo(const struct sockaddr *name, socklen_t nameSize, char *hostName
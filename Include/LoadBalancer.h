@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct LoadBalancerOptions
+{
+    int reportInterval;
+    int runQueueThreshold;
+    int cpuUsageThreshold;
+    size_t maxHandoffSize;
+};
+
+
+struct LoadBalancer
+{
+    int fd;
+    void (*handler)(int, void *, size_t);
+    int reportInterval;
+    int runQueueThreshold;
+    int cpuUsageThreshold;
+    size_t maxHandoffSize;
+    void *buffer;
+    bool isStopped;
+    bool isRunning;
+    int errorNumber;
+    uint64_t reportTime;
+    uint64_t cpuTime;
+    int cpuUsage;
+    bool hasPeerLoad;
+    uint64_t peerReportTime;
+    int peerNumberOfReadyFibers;
+    int peerCPUUsage;
+    void *finalizer;
+};
+
+
+bool LoadBalancer_Initialize(struct LoadBalancer *self, int fd
+                             , void (*handler)(int, void *, size_t)
+                             , const struct LoadBalancerOptions *options);
+void LoadBalancer_Finalize(struct LoadBalancer *self);
+bool LoadBalancer_ShouldMigrate(struct LoadBalancer *self);
+ssize_t LoadBalancer_Migrate(struct LoadBalancer *self, int connectionFD, const void *data
+                             , size_t dataSize, int timeout);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
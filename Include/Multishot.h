@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct Acceptor
+{
+    uint64_t __storage[24];
+};
+
+
+struct Receiver
+{
+    uint64_t __storage[24];
+};
+
+
+bool Acceptor_Initialize(struct Acceptor *self, int fd, int flags);
+void Acceptor_Finalize(struct Acceptor *self);
+int Acceptor_Accept(struct Acceptor *self, int timeout);
+
+bool Receiver_Initialize(struct Receiver *self, int fd);
+void Receiver_Finalize(struct Receiver *self);
+ssize_t Receiver_Receive(struct Receiver *self, const void **buffer, int timeout);
+void Receiver_ReleaseBuffer(struct Receiver *self, const void *buffer);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+enum ReactorCondition
+{
+    ReactorReadable,
+    ReactorWritable
+};
+
+
+struct ReactorWatch
+{
+    uint64_t __storage[8];
+};
+
+
+struct ReactorTimeout
+{
+    uint64_t __storage[7];
+};
+
+
+void Reactor_InitializeWatch(struct ReactorWatch *watch);
+bool Reactor_SetWatch(struct ReactorWatch *watch, int fd, enum ReactorCondition condition
+                      , uintptr_t data, void (*callback)(uintptr_t));
+void Reactor_ClearWatch(struct ReactorWatch *watch);
+void Reactor_InitializeTimeout(struct ReactorTimeout *timeout);
+bool Reactor_SetTimeout(struct ReactorTimeout *timeout, int delay, uintptr_t data
+                        , void (*callback)(uintptr_t));
+void Reactor_ClearTimeout(struct ReactorTimeout *timeout);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
@@ -16,12 +16,46 @@
 extern "C" {
 #endif
 
+struct Fiber;
+
+
+enum SchedulingPolicy
+{
+    SchedulingFirstInFirstOut,
+    SchedulingEarliestDeadlineFirst
+};
+
+
+struct LoadMetrics
+{
+    int numberOfFibers;
+    int numberOfReadyFibers;
+    uint64_t cpuTime;
+};
+
+
 int FiberMain(int argc, char **argv);
 bool AddFiber(void (*function)(uintptr_t), uintptr_t argument);
 bool AddAndRunFiber(void (*function)(uintptr_t), uintptr_t argument);
 void YieldCurrentFiber(void);
+struct Fiber *GetCurrentFiber(void);
+bool YieldToFiber(struct Fiber *fiber);
 NORETURN void ExitCurrentFiber(void);
 bool SleepCurrentFiber(int duration);
+void SetSchedulingPolicy(enum SchedulingPolicy schedulingPolicy);
+int GetNumberOfMissedDeadlines(void);
+uint64_t GetCurrentTime(void);
+uint64_t GetFiberDeadline(void);
+uint64_t SetFiberDeadline(uint64_t deadline);
+void RestoreFiberDeadline(uint64_t deadline);
+bool RequestShutdown(uint64_t deadline);
+bool IsShuttingDown(void);
+bool WaitOnAddress(const volatile int *address, int expectedValue, int timeout);
+int WakeAddress(const volatile int *address, int numberOfWaiters);
+bool GetLoadMetrics(struct LoadMetrics *loadMetrics);
+void SetBusyPolling(int maxDuration);
+bool SwitchToWorkerThread(void);
+void SwitchBackToLoop(void);
 
 #if defined __cplusplus
 } // extern "C"
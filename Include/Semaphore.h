@@ -24,8 +24,8 @@ struct Semaphore
 
 
 bool Semaphore_Initialize(struct Semaphore *self, int value, int minValue, int maxValue);
-void Semaphore_Down(struct Semaphore *self);
-void Semaphore_Up(struct Semaphore *self);
+bool Semaphore_Down(struct Semaphore *self);
+bool Semaphore_Up(struct Semaphore *self);
 
 #if defined __cplusplus
 } // extern "C"
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+struct ZeroCopySender
+{
+    uint64_t __storage[8];
+};
+
+
+bool ZeroCopySender_Initialize(struct ZeroCopySender *self, int fd);
+void ZeroCopySender_Finalize(struct ZeroCopySender *self);
+ssize_t ZeroCopySender_Send(struct ZeroCopySender *self, const void *data, size_t dataSize
+                            , int flags, uint32_t *id, int timeout);
+ssize_t ZeroCopySender_SendMsg(struct ZeroCopySender *self, const struct msghdr *message
+                               , int flags, uint32_t *id, int timeout);
+bool ZeroCopySender_IsCompleted(struct ZeroCopySender *self, uint32_t id);
+bool ZeroCopySender_WaitForCompletion(struct ZeroCopySender *self, uint32_t id, int timeout);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
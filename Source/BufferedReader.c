@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "BufferedReader.h"
+
+#include <sys/uio.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "IO.h"
+#include "Timer.h"
+
+
+static bool BufferedReader_Rearrange(struct BufferedReader *, size_t);
+static ssize_t BufferedReader_Fill(struct BufferedReader *, uint64_t);
+static size_t BufferedReader_Find(const struct BufferedReader *, int, size_t);
+static const void *BufferedReader_GetData(struct BufferedReader *, size_t);
+static void BufferedReader_Consume(struct BufferedReader *, size_t);
+
+
+
+struct Timer Timer;
+
+
+bool
+BufferedReader_Initialize(struct BufferedReader *self, int fd, size_t bufferSize
+                          , size_t maxBufferSize)
+{
+    if (self == NULL || fd < 0 || bufferSize == 0 || bufferSize > maxBufferSize) {
+        errno = EINVAL;
+        return false;
+    }
+
+    self->buffer = malloc(bufferSize);
+
+    if (self->buffer == NULL) {
+        return false;
+    }
+
+    self->fd = fd;
+    self->bufferSize = bufferSize;
+    self->maxBufferSize = maxBufferSize;
+    self->dataOffset = 0;
+    self->dataSize = 0;
+    return true;
+}
+
+
+void
+BufferedReader_Finalize(const struct BufferedReader *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->buffer);
+}
+
+
+ssize_t
+BufferedReader_Read(struct BufferedReader *self, void *buffer, size_t bufferSize, int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (self->dataSize == 0) {
+        if (bufferSize >= self->bufferSize) {
+            return Read(self->fd, buffer, bufferSize, timeout);
+        }
+
+        ssize_t numberOfBytes = BufferedReader_Fill(self, Timer_GetDeadline(timeout));
+
+        if (numberOfBytes <= 0) {
+            return numberOfBytes;
+        }
+    }
+
+    if (bufferSize > self->dataSize) {
+        bufferSize = self->dataSize;
+    }
+
+    memcpy(buffer, BufferedReader_GetData(self, bufferSize), bufferSize);
+    BufferedReader_Consume(self, bufferSize);
+    return bufferSize;
+}
+
+
+ssize_t
+BufferedReader_Peek(struct BufferedReader *self, const void **data, size_t dataSize, int timeout)
+{
+    if (self == NULL || data == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t deadline = Timer_GetDeadline(timeout);
+
+    while (self->dataSize < dataSize) {
+        ssize_t numberOfBytes = BufferedReader_Fill(self, deadline);
+
+        if (numberOfBytes < 0) {
+            return -1;
+        }
+
+        if (numberOfBytes == 0) {
+            dataSize = self->dataSize;
+            break;
+        }
+    }
+
+    *data = BufferedReader_GetData(self, dataSize);
+    return *data == NULL ? -1 : (ssize_t)dataSize;
+}
+
+
+ssize_t
+BufferedReader_Skip(struct BufferedReader *self, size_t dataSize, int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t deadline = Timer_GetDeadline(timeout);
+    size_t numberOfBytesSkipped = 0;
+
+    for (;;) {
+        size_t numberOfBytes = dataSize - numberOfBytesSkipped;
+
+        if (numberOfBytes > self->dataSize) {
+            numberOfBytes = self->dataSize;
+        }
+
+        BufferedReader_Consume(self, numberOfBytes);
+        numberOfBytesSkipped += numberOfBytes;
+
+        if (numberOfBytesSkipped == dataSize) {
+            break;
+        }
+
+        ssize_t result = BufferedReader_Fill(self, deadline);
+
+        if (result <= 0) {
+            if (result < 0 && numberOfBytesSkipped == 0) {
+                return -1;
+            }
+
+            break;
+        }
+    }
+
+    return numberOfBytesSkipped;
+}
+
+
+ssize_t
+BufferedReader_ReadUntil(struct BufferedReader *self, int delimiter, const void **data
+                         , int timeout)
+{
+    if (self == NULL || data == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t deadline = Timer_GetDeadline(timeout);
+    size_t dataSize = 0;
+
+    for (;;) {
+        size_t i = BufferedReader_Find(self, delimiter, dataSize);
+
+        if (i < self->dataSize) {
+            dataSize = i + 1;
+            break;
+        }
+
+        dataSize = self->dataSize;
+        ssize_t numberOfBytes = BufferedReader_Fill(self, deadline);
+
+        if (numberOfBytes < 0) {
+            return -1;
+        }
+
+        if (numberOfBytes == 0) {
+            if (dataSize == 0) {
+                return 0;
+            }
+
+            break;
+        }
+    }
+
+    *data = BufferedReader_GetData(self, dataSize);
+
+    if (*data == NULL) {
+        return -1;
+    }
+
+    BufferedReader_Consume(self, dataSize);
+    return dataSize;
+}
+
+
+ssize_t
+BufferedReader_ReadLine(struct BufferedReader *self, const void **data, int timeout)
+{
+    return BufferedReader_ReadUntil(self, '\n', data, timeout);
+}
+
+
+static bool
+BufferedReader_Rearrange(struct BufferedReader *self, size_t bufferSize)
+{
+    char *buffer = malloc(bufferSize);
+
+    if (buffer == NULL) {
+        return false;
+    }
+
+    size_t dataSize1 = self->bufferSize - self->dataOffset;
+
+    if (dataSize1 >= self->dataSize) {
+        memcpy(buffer, self->buffer + self->dataOffset, self->dataSize);
+    } else {
+        memcpy(buffer, self->buffer + self->dataOffset, dataSize1);
+        memcpy(buffer + dataSize1, self->buffer, self->dataSize - dataSize1);
+    }
+
+    free(self->buffer);
+    self->buffer = buffer;
+    self->bufferSize = bufferSize;
+    self->dataOffset = 0;
+    return true;
+}
+
+
+static ssize_t
+BufferedReader_Fill(struct BufferedReader *self, uint64_t deadline)
+{
+    if (self->dataSize == self->bufferSize) {
+        if (self->bufferSize == self->maxBufferSize) {
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        size_t bufferSize = self->bufferSize <= self->maxBufferSize / 2 ? 2 * self->bufferSize
+                                                                         : self->maxBufferSize;
+
+        if (!BufferedReader_Rearrange(self, bufferSize)) {
+            return -1;
+        }
+    }
+
+    if (self->dataSize == 0) {
+        self->dataOffset = 0;
+    }
+
+    size_t dataEnd = self->dataOffset + self->dataSize;
+    ssize_t numberOfBytes;
+
+    if (dataEnd < self->bufferSize && self->dataOffset >= 1) {
+        struct iovec vector[2] = {
+            {.iov_base = self->buffer + dataEnd, .iov_len = self->bufferSize - dataEnd},
+            {.iov_base = self->buffer, .iov_len = self->dataOffset}
+        };
+
+        numberOfBytes = ReadV(self->fd, vector, 2, Timer_ApplyDeadline(&Timer, -1, deadline));
+    } else {
+        dataEnd %= self->bufferSize;
+        size_t freeSize = dataEnd >= self->dataOffset ? self->bufferSize - dataEnd
+                                                     : self->dataOffset - dataEnd;
+        numberOfBytes = Read(self->fd, self->buffer + dataEnd, freeSize
+                             , Timer_ApplyDeadline(&Timer, -1, deadline));
+    }
+
+    if (numberOfBytes >= 1) {
+        self->dataSize += numberOfBytes;
+    }
+
+    return numberOfBytes;
+}
+
+
+static size_t
+BufferedReader_Find(const struct BufferedReader *self, int delimiter, size_t offset)
+{
+    size_t dataSize1 = self->bufferSize - self->dataOffset;
+
+    if (offset < dataSize1) {
+        size_t size = dataSize1 < self->dataSize ? dataSize1 : self->dataSize;
+        const char *data = self->buffer + self->dataOffset;
+        const char *end = memchr(data + offset, delimiter, size - offset);
+
+        if (end != NULL) {
+            return end - data;
+        }
+
+        offset = size;
+    }
+
+    if (offset < self->dataSize) {
+        const char *end = memchr(self->buffer + (offset - dataSize1), delimiter
+                                 , self->dataSize - offset);
+
+        if (end != NULL) {
+            return dataSize1 + (end - self->buffer);
+        }
+    }
+
+    return self->dataSize;
+}
+
+
+static const void *
+BufferedReader_GetData(struct BufferedReader *self, size_t dataSize)
+{
+    if (self->dataOffset + dataSize > self->bufferSize
+        && !BufferedReader_Rearrange(self, self->bufferSize)) {
+        return NULL;
+    }
+
+    return self->buffer + self->dataOffset;
+}
+
+
+static void
+BufferedReader_Consume(struct BufferedReader *self, size_t dataSize)
+{
+    self->dataOffset = (self->dataOffset + dataSize) % self->bufferSize;
+    self->dataSize -= dataSize;
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "BufferedWriter.h"
+
+#include <unistd.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "IO.h"
+
+
+static ssize_t BufferedWriter_DoWrite(struct BufferedWriter *, const void *, size_t, int);
+static ssize_t BufferedWriter_DoWriteReference(struct BufferedWriter *, const void *, size_t, int);
+static bool BufferedWriter_DoFlush(struct BufferedWriter *, int);
+static bool BufferedWriter_AddData(struct BufferedWriter *, const void *, size_t);
+static ssize_t BufferedWriter_Commit(struct BufferedWriter *, size_t, int);
+static void BufferedWriter_Consume(struct BufferedWriter *, size_t);
+static void BufferedWriter_TryFlush(struct BufferedWriter *);
+
+static void BufferedWriterCallback(uintptr_t);
+
+
+bool
+BufferedWriter_Initialize(struct BufferedWriter *self, int fd, size_t bufferSize
+                          , size_t highWaterMark)
+{
+    if (self == NULL || fd < 0 || bufferSize == 0 || highWaterMark == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    self->buffer = malloc(bufferSize);
+
+    if (self->buffer == NULL) {
+        return false;
+    }
+
+    self->fd = fd;
+    self->bufferSize = bufferSize;
+    self->bufferUsage = 0;
+    self->highWaterMark = highWaterMark;
+    self->vector = NULL;
+    self->vectorLength = 0;
+    self->vectorCapacity = 0;
+    self->vectorOffset = 0;
+    self->dataSize = 0;
+    self->isFlushing = false;
+    self->errorNumber = 0;
+    Semaphore_Initialize(&self->semaphore, 1, 0, 1);
+    Reactor_InitializeTimeout(&self->timeout);
+    Reactor_InitializeWatch(&self->watch);
+    return true;
+}
+
+
+void
+BufferedWriter_Finalize(struct BufferedWriter *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    Reactor_ClearTimeout(&self->timeout);
+    Reactor_ClearWatch(&self->watch);
+
+    if (!self->isFlushing && self->errorNumber == 0) {
+        BufferedWriter_TryFlush(self);
+    }
+
+    free(self->vector);
+    free(self->buffer);
+}
+
+
+ssize_t
+BufferedWriter_Write(struct BufferedWriter *self, const void *data, size_t dataSize, int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!Semaphore_Down(&self->semaphore)) {
+        return -1;
+    }
+
+    ssize_t result = BufferedWriter_DoWrite(self, data, dataSize, timeout);
+    Semaphore_Up(&self->semaphore);
+    return result;
+}
+
+
+ssize_t
+BufferedWriter_WriteReference(struct BufferedWriter *self, const void *data, size_t dataSize
+                              , int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!Semaphore_Down(&self->semaphore)) {
+        return -1;
+    }
+
+    ssize_t result = BufferedWriter_DoWriteReference(self, data, dataSize, timeout);
+    Semaphore_Up(&self->semaphore);
+    return result;
+}
+
+
+bool
+BufferedWriter_Flush(struct BufferedWriter *self, int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    if (!Semaphore_Down(&self->semaphore)) {
+        return false;
+    }
+
+    bool result = BufferedWriter_DoFlush(self, timeout);
+    Semaphore_Up(&self->semaphore);
+    return result;
+}
+
+
+static ssize_t
+BufferedWriter_DoWrite(struct BufferedWriter *self, const void *data, size_t dataSize
+                       , int timeout)
+{
+    if (self->errorNumber != 0) {
+        errno = self->errorNumber;
+        return -1;
+    }
+
+    if (dataSize > self->bufferSize - self->bufferUsage) {
+        if (!BufferedWriter_DoFlush(self, timeout)) {
+            return -1;
+        }
+
+        if (dataSize > self->bufferSize) {
+            return WriteAll(self->fd, data, dataSize, timeout);
+        }
+    }
+
+    char *buffer = self->buffer + self->bufferUsage;
+    memcpy(buffer, data, dataSize);
+
+    if (self->vectorLength > self->vectorOffset
+        && (char *)self->vector[self->vectorLength - 1].iov_base
+           + self->vector[self->vectorLength - 1].iov_len == buffer) {
+        self->vector[self->vectorLength - 1].iov_len += dataSize;
+    } else if (!BufferedWriter_AddData(self, buffer, dataSize)) {
+        return -1;
+    }
+
+    self->bufferUsage += dataSize;
+    return BufferedWriter_Commit(self, dataSize, timeout);
+}
+
+
+static ssize_t
+BufferedWriter_DoWriteReference(struct BufferedWriter *self, const void *data, size_t dataSize
+                                , int timeout)
+{
+    if (self->errorNumber != 0) {
+        errno = self->errorNumber;
+        return -1;
+    }
+
+    if (!BufferedWriter_AddData(self, data, dataSize)) {
+        return -1;
+    }
+
+    return BufferedWriter_Commit(self, dataSize, timeout);
+}
+
+
+static bool
+BufferedWriter_DoFlush(struct BufferedWriter *self, int timeout)
+{
+    if (self->errorNumber != 0) {
+        errno = self->errorNumber;
+        return false;
+    }
+
+    Reactor_ClearTimeout(&self->timeout);
+    Reactor_ClearWatch(&self->watch);
+
+    if (self->dataSize == 0) {
+        return true;
+    }
+
+    self->isFlushing = true;
+    ssize_t numberOfBytes = WriteVAll(self->fd, &self->vector[self->vectorOffset]
+                                      , self->vectorLength - self->vectorOffset, timeout);
+    self->isFlushing = false;
+
+    if (numberOfBytes >= 1) {
+        self->dataSize -= numberOfBytes;
+        BufferedWriter_Consume(self, 0);
+    }
+
+    if (self->dataSize >= 1) {
+        int errorNumber = errno;
+
+        if (errorNumber != EINTR) {
+            self->errorNumber = errorNumber;
+        } else if (!Reactor_SetTimeout(&self->timeout, 0, (uintptr_t)self
+                                       , BufferedWriterCallback)) {
+            self->errorNumber = errno;
+        }
+
+        errno = errorNumber;
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool
+BufferedWriter_AddData(struct BufferedWriter *self, const void *data, size_t dataSize)
+{
+    if (self->vectorLength == self->vectorCapacity) {
+        if (self->vectorOffset >= 1) {
+            memmove(self->vector, &self->vector[self->vectorOffset]
+                    , (self->vectorLength - self->vectorOffset) * sizeof *self->vector);
+            self->vectorLength -= self->vectorOffset;
+            self->vectorOffset = 0;
+        } else {
+            int vectorCapacity = self->vectorCapacity == 0 ? 16 : 2 * self->vectorCapacity;
+            struct iovec *vector = realloc(self->vector, vectorCapacity * sizeof *vector);
+
+            if (vector == NULL) {
+                return false;
+            }
+
+            self->vector = vector;
+            self->vectorCapacity = vectorCapacity;
+        }
+    }
+
+    self->vector[self->vectorLength].iov_base = (void *)data;
+    self->vector[self->vectorLength].iov_len = dataSize;
+    ++self->vectorLength;
+    return true;
+}
+
+
+static ssize_t
+BufferedWriter_Commit(struct BufferedWriter *self, size_t dataSize, int timeout)
+{
+    self->dataSize += dataSize;
+
+    if (self->dataSize >= self->highWaterMark) {
+        BufferedWriter_DoFlush(self, timeout);
+    } else if (!Reactor_SetTimeout(&self->timeout, 0, (uintptr_t)self, BufferedWriterCallback)) {
+        self->errorNumber = errno;
+    }
+
+    return dataSize;
+}
+
+
+static void
+BufferedWriter_Consume(struct BufferedWriter *self, size_t dataSize)
+{
+    self->dataSize -= dataSize;
+
+    while (self->vectorOffset < self->vectorLength) {
+        struct iovec *vectorItem = &self->vector[self->vectorOffset];
+
+        if (dataSize < vectorItem->iov_len) {
+            vectorItem->iov_base = (char *)vectorItem->iov_base + dataSize;
+            vectorItem->iov_len -= dataSize;
+            break;
+        }
+
+        dataSize -= vectorItem->iov_len;
+        ++self->vectorOffset;
+    }
+
+    if (self->vectorOffset == self->vectorLength) {
+        self->vectorLength = 0;
+        self->vectorOffset = 0;
+        self->bufferUsage = 0;
+    }
+}
+
+
+static void
+BufferedWriter_TryFlush(struct BufferedWriter *self)
+{
+    while (self->dataSize >= 1) {
+        int vectorLength = self->vectorLength - self->vectorOffset;
+        ssize_t numberOfBytes;
+
+        do {
+            numberOfBytes = writev(self->fd, &self->vector[self->vectorOffset]
+                                   , vectorLength < IOV_MAX ? vectorLength : IOV_MAX);
+        } while (numberOfBytes < 0 && errno == EINTR);
+
+        if (numberOfBytes < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                self->errorNumber = errno;
+            }
+
+            return;
+        }
+
+        BufferedWriter_Consume(self, numberOfBytes);
+    }
+}
+
+
+static void
+BufferedWriterCallback(uintptr_t argument)
+{
+    struct BufferedWriter *self = (struct BufferedWriter *)argument;
+
+    if (self->isFlushing || self->errorNumber != 0 || self->dataSize == 0) {
+        Reactor_ClearWatch(&self->watch);
+        return;
+    }
+
+    BufferedWriter_TryFlush(self);
+
+    if (self->errorNumber != 0 || self->dataSize == 0) {
+        Reactor_ClearWatch(&self->watch);
+    } else if (!Reactor_SetWatch(&self->watch, self->fd, ReactorWritable, (uintptr_t)self
+                                 , BufferedWriterCallback)) {
+        self->errorNumber = errno;
+    }
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "DirectReader.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "IO.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
+
+
+#define DIRECT_READER_ALIGNMENT 4096
+
+
+struct DirectRead
+{
+    struct Work work;
+    struct DirectReader *reader;
+    void *buffer;
+    off_t offset;
+    ssize_t result;
+    int errorNumber;
+    bool isPending;
+};
+
+
+static void DirectReader_Submit(struct DirectReader *, struct DirectRead *);
+static void DirectReader_Wait(struct DirectReader *, struct DirectRead *);
+
+static void DirectReadWrapper(uintptr_t);
+static void DirectReadCallback(uintptr_t);
+
+
+struct Scheduler Scheduler;
+struct ThreadPool ThreadPool;
+
+
+bool
+DirectReader_Initialize(struct DirectReader *self, const char *path, size_t chunkSize
+                        , int numberOfRequests)
+{
+    if (self == NULL || path == NULL || chunkSize == 0
+        || chunkSize % DIRECT_READER_ALIGNMENT != 0 || numberOfRequests < 1) {
+        errno = EINVAL;
+        return false;
+    }
+
+    struct DirectRead *requests = calloc(numberOfRequests, sizeof *requests);
+
+    if (requests == NULL) {
+        return false;
+    }
+
+    int i;
+
+    for (i = 0; i < numberOfRequests; ++i) {
+        int errorNumber = posix_memalign(&requests[i].buffer, DIRECT_READER_ALIGNMENT
+                                         , chunkSize);
+
+        if (errorNumber != 0) {
+            while (--i >= 0) {
+                free(requests[i].buffer);
+            }
+
+            free(requests);
+            errno = errorNumber;
+            return false;
+        }
+
+        requests[i].reader = self;
+    }
+
+    self->isDirect = true;
+    self->fd = Open(path, O_RDONLY | O_CLOEXEC | O_DIRECT, 0);
+
+    if (self->fd < 0 && errno == EINVAL) {
+        self->isDirect = false;
+        self->fd = Open(path, O_RDONLY | O_CLOEXEC, 0);
+    }
+
+    if (self->fd < 0) {
+        for (i = 0; i < numberOfRequests; ++i) {
+            free(requests[i].buffer);
+        }
+
+        free(requests);
+        return false;
+    }
+
+    if (!self->isDirect) {
+        posix_fadvise(self->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    self->isEOF = false;
+    self->errorNumber = 0;
+    self->chunkSize = chunkSize;
+    self->numberOfRequests = numberOfRequests;
+    self->requestIndex = 0;
+    self->nextOffset = 0;
+    self->requests = requests;
+    self->waiter = NULL;
+
+    for (i = 0; i < numberOfRequests; ++i) {
+        DirectReader_Submit(self, &requests[i]);
+    }
+
+    return true;
+}
+
+
+void
+DirectReader_Finalize(struct DirectReader *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    struct DirectRead *requests = self->requests;
+    int i;
+
+    for (i = 0; i < self->numberOfRequests; ++i) {
+        DirectReader_Wait(self, &requests[i]);
+        free(requests[i].buffer);
+    }
+
+    free(requests);
+    Close(self->fd);
+}
+
+
+ssize_t
+DirectReader_Read(struct DirectReader *self, const void **chunk)
+{
+    if (self == NULL || chunk == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (self->errorNumber != 0) {
+        errno = self->errorNumber;
+        return -1;
+    }
+
+    struct DirectRead *requests = self->requests;
+    int previousRequestIndex = (self->requestIndex + self->numberOfRequests - 1)
+                               % self->numberOfRequests;
+
+    if (!requests[previousRequestIndex].isPending) {
+        DirectReader_Submit(self, &requests[previousRequestIndex]);
+    }
+
+    struct DirectRead *request = &requests[self->requestIndex];
+    DirectReader_Wait(self, request);
+
+    if (request->result < 0) {
+        self->errorNumber = request->errorNumber;
+        errno = self->errorNumber;
+        return -1;
+    }
+
+    if ((size_t)request->result < self->chunkSize) {
+        self->isEOF = true;
+    }
+
+    if (!__atomic_load_n(&self->isDirect, __ATOMIC_ACQUIRE) && request->result >= 1) {
+        posix_fadvise(self->fd, request->offset, request->result, POSIX_FADV_DONTNEED);
+    }
+
+    self->requestIndex = (self->requestIndex + 1) % self->numberOfRequests;
+    *chunk = request->buffer;
+    return request->result;
+}
+
+
+static void
+DirectReader_Submit(struct DirectReader *self, struct DirectRead *request)
+{
+    if (self->isEOF) {
+        request->result = 0;
+        return;
+    }
+
+    request->offset = self->nextOffset;
+    request->isPending = true;
+    self->nextOffset += self->chunkSize;
+    ThreadPool_PostWork(&ThreadPool, &request->work, DirectReadWrapper, (uintptr_t)request
+                        , (uintptr_t)request, DirectReadCallback);
+}
+
+
+static void
+DirectReader_Wait(struct DirectReader *self, struct DirectRead *request)
+{
+    while (request->isPending) {
+        self->waiter = Scheduler_GetCurrentFiber(&Scheduler);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+    }
+}
+
+
+static void
+DirectReadWrapper(uintptr_t argument)
+{
+    struct DirectRead *request = (struct DirectRead *)argument;
+    struct DirectReader *reader = request->reader;
+
+    for (;;) {
+        do {
+            request->result = pread(reader->fd, request->buffer, reader->chunkSize
+                                    , request->offset);
+        } while (request->result < 0 && errno == EINTR);
+
+        if (request->result >= 0 || errno != EINVAL
+            || !__atomic_load_n(&reader->isDirect, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        int flags = fcntl(reader->fd, F_GETFL);
+
+        if (flags < 0 || fcntl(reader->fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+            break;
+        }
+
+        __atomic_store_n(&reader->isDirect, false, __ATOMIC_RELEASE);
+    }
+
+    request->errorNumber = errno;
+}
+
+
+static void
+DirectReadCallback(uintptr_t argument)
+{
+    struct DirectRead *request = (struct DirectRead *)argument;
+    struct DirectReader *reader = request->reader;
+    request->isPending = false;
+
+    if (reader->waiter != NULL) {
+        struct Fiber *waiter = reader->waiter;
+        reader->waiter = NULL;
+        Scheduler_ResumeFiber(&Scheduler, waiter);
+    }
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "FiberPool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "List.h"
+#include "Scheduler.h"
+#include "Utility.h"
+
+
+struct FiberPoolWorker
+{
+    struct ListItem listItem;
+    struct Fiber *fiber;
+};
+
+
+static void FiberPool_WakeIdleWorker(struct FiberPool *);
+static void FiberPool_Work(struct FiberPool *);
+
+static void WorkerStart(uintptr_t);
+
+
+struct Scheduler Scheduler;
+
+
+bool
+FiberPool_Initialize(struct FiberPool *self, int minNumberOfFibers, int maxNumberOfFibers)
+{
+    if (self == NULL) {
+        return true;
+    }
+
+    if (minNumberOfFibers < 0 || maxNumberOfFibers < 1 || minNumberOfFibers > maxNumberOfFibers) {
+        errno = EINVAL;
+        return false;
+    }
+
+    self->minNumberOfFibers = minNumberOfFibers;
+    self->maxNumberOfFibers = maxNumberOfFibers;
+    self->numberOfFibers = 0;
+    self->isStopped = false;
+    List_Initialize(LIST_HEAD(self->jobList));
+    List_Initialize(LIST_HEAD(self->idleWorkerList));
+    List_Initialize(LIST_HEAD(self->busyWorkerList));
+    self->finalizer = NULL;
+
+    while (self->numberOfFibers < minNumberOfFibers) {
+        if (!Scheduler_AddFiber(&Scheduler, WorkerStart, (uintptr_t)self)) {
+            int errorNumber = errno;
+            FiberPool_Finalize(self);
+            errno = errorNumber;
+            return false;
+        }
+
+        ++self->numberOfFibers;
+    }
+
+    return true;
+}
+
+
+bool
+FiberPool_Finalize(struct FiberPool *self)
+{
+    if (self == NULL) {
+        return true;
+    }
+
+    struct Fiber *fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    struct ListItem *workerListItem;
+
+    FOR_EACH_LIST_ITEM(workerListItem, LIST_HEAD(self->busyWorkerList)) {
+        struct FiberPoolWorker *worker = CONTAINER_OF(workerListItem, struct FiberPoolWorker
+                                                      , listItem);
+
+        if (worker->fiber == fiber) {
+            errno = EDEADLK;
+            return false;
+        }
+    }
+
+    self->isStopped = true;
+
+    while (!List_IsEmpty(LIST_HEAD(self->idleWorkerList))) {
+        FiberPool_WakeIdleWorker(self);
+    }
+
+    if (self->numberOfFibers >= 1) {
+        self->finalizer = Scheduler_GetCurrentFiber(&Scheduler);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+        self->finalizer = NULL;
+    }
+
+    return true;
+}
+
+
+bool
+FiberPool_PostJob(struct FiberPool *self, struct FiberPoolJob *job, void (*function)(uintptr_t)
+                  , uintptr_t argument)
+{
+    if (self == NULL || job == NULL || function == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    if (self->isStopped) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    if (!List_IsEmpty(LIST_HEAD(self->idleWorkerList))) {
+        FiberPool_WakeIdleWorker(self);
+    } else if (self->numberOfFibers < self->maxNumberOfFibers) {
+        if (!Scheduler_AddFiber(&Scheduler, WorkerStart, (uintptr_t)self)) {
+            return false;
+        }
+
+        ++self->numberOfFibers;
+    }
+
+    job->function = function;
+    job->argument = argument;
+    List_InsertBack(LIST_HEAD(self->jobList), (struct ListItem *)job->listItem);
+    return true;
+}
+
+
+static void
+FiberPool_WakeIdleWorker(struct FiberPool *self)
+{
+    struct FiberPoolWorker *worker = CONTAINER_OF(List_GetFront(LIST_HEAD(self->idleWorkerList))
+                                                  , struct FiberPoolWorker, listItem);
+    ListItem_Remove(&worker->listItem);
+    Scheduler_ResumeFiber(&Scheduler, worker->fiber);
+}
+
+
+static void
+FiberPool_Work(struct FiberPool *self)
+{
+    struct FiberPoolWorker worker;
+    worker.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+
+    for (;;) {
+        if (List_IsEmpty(LIST_HEAD(self->jobList))) {
+            if (self->isStopped || self->numberOfFibers > self->minNumberOfFibers) {
+                break;
+            }
+
+            List_InsertBack(LIST_HEAD(self->idleWorkerList), &worker.listItem);
+            Scheduler_SuspendCurrentFiber(&Scheduler);
+            continue;
+        }
+
+        struct FiberPoolJob *job = CONTAINER_OF(List_GetFront(LIST_HEAD(self->jobList))
+                                                , struct FiberPoolJob, listItem);
+        ListItem_Remove((struct ListItem *)job->listItem);
+        Fiber_SetDeadline(worker.fiber, UINT64_MAX);
+        List_InsertBack(LIST_HEAD(self->busyWorkerList), &worker.listItem);
+        job->function(job->argument);
+        ListItem_Remove(&worker.listItem);
+    }
+
+    if (--self->numberOfFibers == 0 && self->finalizer != NULL) {
+        Scheduler_ResumeFiber(&Scheduler, self->finalizer);
+    }
+}
+
+
+static void
+WorkerStart(uintptr_t argument)
+{
+    FiberPool_Work((struct FiberPool *)argument);
+}
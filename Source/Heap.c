@@ -135,6 +135,16 @@ Heap_RemoveNode(struct Heap *self, const struct HeapNode *node
 }
 
 
+bool
+Heap_HasNode(const struct Heap *self, const struct HeapNode *node)
+{
+    assert(self != NULL);
+    assert(node != NULL);
+    return node->slotNumber >= 0 && node->slotNumber < self->numberOfNodes
+           && *Heap_LocateSlot(self, node->slotNumber) == node;
+}
+
+
 static bool
 Heap_IncreaseSegments(struct Heap *self)
 {
@@ -39,6 +39,7 @@ void Heap_AdjustNode(struct Heap *, struct HeapNode *, int (*)(const struct Heap
                                                                , const struct HeapNode *));
 void Heap_RemoveNode(struct Heap *, const struct HeapNode *, int (*)(const struct HeapNode *
                                                                      , const struct HeapNode *));
+bool Heap_HasNode(const struct Heap *, const struct HeapNode *);
 
 
 static inline struct HeapNode *
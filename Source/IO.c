@@ -9,35 +9,81 @@
 #include <stddef.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <netdb.h>
 
 #include "Scheduler.h"
 #include "IOPoller.h"
+#include "IORing.h"
 #include "Timer.h"
 #include "ThreadPool.h"
+#include "Shutdown.h"
+#include "Utility.h"
 #include "Logging.h"
 
 
 static bool WaitForFD(int, enum IOCondition, int);
+static bool WaitForConnection(int, int);
+static bool WaitForFDOrShutdown(int, enum IOCondition, int, enum ShutdownState);
 static void WaitForFDCallback1(uintptr_t);
 static void WaitForFDCallback2(uintptr_t);
 static void WaitForFDCallback3(uintptr_t);
+static void WaitForFDCallback4(uintptr_t);
+static void WaitForFDCallback5(uintptr_t);
+#if defined USE_IO_URING
+static ssize_t DoIORingOperation(int, int, void *, unsigned int, uint64_t, unsigned int, int
+                                 , enum ShutdownState);
+static void DoIORingOperationCallback1(uintptr_t);
+static void DoIORingOperationCallback2(uintptr_t);
+#endif
+static ssize_t TryPReadV(int, const struct iovec *, int, off_t);
 static void DoWork(void (*)(uintptr_t), uintptr_t);
 static void DoWorkCallback(uintptr_t);
+static void RelayData(uintptr_t);
+static void RelayDataWrapper(uintptr_t);
+static void OpenWrapper(uintptr_t);
+static void PReadWrapper(uintptr_t);
+static void PWriteWrapper(uintptr_t);
+static void PReadVWrapper(uintptr_t);
+static void FsyncWrapper(uintptr_t);
+static void FStatWrapper(uintptr_t);
+static void UnlinkWrapper(uintptr_t);
 static void GetAddrInfoWrapper(uintptr_t);
 static void GetNameInfoWrapper(uintptr_t);
 
 static void xgetsockopt(int, int, int, void *, socklen_t *);
 
 
+struct RelayDirection
+{
+    int inFD;
+    int outFD;
+    int pipeSize;
+    int timeout;
+    uint64_t numberOfBytes;
+    bool isHalfClosed;
+    int errorNumber;
+};
+
+
 struct Scheduler Scheduler;
 struct IOPoller IOPoller;
+struct IORing IORing;
 struct Timer Timer;
 struct ThreadPool ThreadPool;
+struct Shutdown Shutdown;
+
+static bool NoWaitReadIsUnsupported;
+static uint64_t NumberOfInlineFileReads;
+static uint64_t NumberOfOffloadedFileReads;
 
 
 int
@@ -50,6 +96,10 @@ Pipe2(int *fds, int flags)
 ssize_t
 Read(int fd, void *buffer, size_t bufferSize, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOReadable) && !WaitForFD(fd, IOReadable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -61,7 +111,22 @@ Read(int fd, void *buffer, size_t bufferSize, int timeout)
             return numberOfBytes;
         }
 
-        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOReadable, timeout)) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+#if defined USE_IO_URING
+        if (IORing_IsAvailable(&IORing)) {
+            numberOfBytes = DoIORingOperation(IORING_OP_READ, fd, buffer, bufferSize, -1, 0
+                                              , timeout, ShutdownExpired);
+
+            if (numberOfBytes >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return numberOfBytes;
+            }
+        }
+#endif
+
+        if (!WaitForFD(fd, IOReadable, timeout)) {
             return -1;
         }
     }
@@ -71,6 +136,10 @@ Read(int fd, void *buffer, size_t bufferSize, int timeout)
 ssize_t
 Write(int fd, const void *data, size_t dataSize, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOWritable) && !WaitForFD(fd, IOWritable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -82,7 +151,22 @@ Write(int fd, const void *data, size_t dataSize, int timeout)
             return numberOfBytes;
         }
 
-        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOWritable, timeout)) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+#if defined USE_IO_URING
+        if (IORing_IsAvailable(&IORing)) {
+            numberOfBytes = DoIORingOperation(IORING_OP_WRITE, fd, (void *)data, dataSize, -1, 0
+                                              , timeout, ShutdownExpired);
+
+            if (numberOfBytes >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return numberOfBytes;
+            }
+        }
+#endif
+
+        if (!WaitForFD(fd, IOWritable, timeout)) {
             return -1;
         }
     }
@@ -92,6 +176,10 @@ Write(int fd, const void *data, size_t dataSize, int timeout)
 ssize_t
 ReadV(int fd, const struct iovec *vector, int vectorLength, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOReadable) && !WaitForFD(fd, IOReadable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -113,6 +201,10 @@ ReadV(int fd, const struct iovec *vector, int vectorLength, int timeout)
 ssize_t
 WriteV(int fd, const struct iovec *vector, int vectorLength, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOWritable) && !WaitForFD(fd, IOWritable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -131,6 +223,100 @@ WriteV(int fd, const struct iovec *vector, int vectorLength, int timeout)
 }
 
 
+ssize_t
+ReadFull(int fd, void *buffer, size_t bufferSize, int timeout)
+{
+    uint64_t deadline = Timer_GetDeadline(timeout);
+    size_t numberOfBytesRead = 0;
+
+    while (numberOfBytesRead < bufferSize) {
+        ssize_t numberOfBytes = Read(fd, (char *)buffer + numberOfBytesRead
+                                     , bufferSize - numberOfBytesRead
+                                     , Timer_ApplyDeadline(&Timer, -1, deadline));
+
+        if (numberOfBytes == 0) {
+            break;
+        }
+
+        if (numberOfBytes < 0) {
+            return numberOfBytesRead == 0 ? -1 : (ssize_t)numberOfBytesRead;
+        }
+
+        numberOfBytesRead += numberOfBytes;
+    }
+
+    return numberOfBytesRead;
+}
+
+
+ssize_t
+WriteAll(int fd, const void *data, size_t dataSize, int timeout)
+{
+    uint64_t deadline = Timer_GetDeadline(timeout);
+    size_t numberOfBytesWritten = 0;
+
+    while (numberOfBytesWritten < dataSize) {
+        ssize_t numberOfBytes = Write(fd, (const char *)data + numberOfBytesWritten
+                                      , dataSize - numberOfBytesWritten
+                                      , Timer_ApplyDeadline(&Timer, -1, deadline));
+
+        if (numberOfBytes < 0) {
+            return numberOfBytesWritten == 0 ? -1 : (ssize_t)numberOfBytesWritten;
+        }
+
+        numberOfBytesWritten += numberOfBytes;
+    }
+
+    return numberOfBytesWritten;
+}
+
+
+ssize_t
+WriteVAll(int fd, struct iovec *vector, int vectorLength, int timeout)
+{
+    uint64_t deadline = Timer_GetDeadline(timeout);
+    size_t numberOfBytesWritten = 0;
+
+    for (;;) {
+        while (vectorLength >= 1 && vector->iov_len == 0) {
+            ++vector;
+            --vectorLength;
+        }
+
+        if (vectorLength == 0) {
+            break;
+        }
+
+        ssize_t numberOfBytes = WriteV(fd, vector, vectorLength < IOV_MAX ? vectorLength : IOV_MAX
+                                       , Timer_ApplyDeadline(&Timer, -1, deadline));
+
+        if (numberOfBytes < 0) {
+            return numberOfBytesWritten == 0 ? -1 : (ssize_t)numberOfBytesWritten;
+        }
+
+        numberOfBytesWritten += numberOfBytes;
+
+        while ((size_t)numberOfBytes >= vector->iov_len) {
+            numberOfBytes -= vector->iov_len;
+            vector->iov_len = 0;
+
+            if (--vectorLength == 0) {
+                break;
+            }
+
+            ++vector;
+        }
+
+        if (vectorLength >= 1) {
+            vector->iov_base = (char *)vector->iov_base + numberOfBytes;
+            vector->iov_len -= numberOfBytes;
+        }
+    }
+
+    return numberOfBytesWritten;
+}
+
+
 int
 Socket(int domain, int type, int protocol)
 {
@@ -138,9 +324,20 @@ Socket(int domain, int type, int protocol)
 }
 
 
+int
+SetSocketBusyPoll(int fd, int duration)
+{
+    return setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &duration, sizeof duration);
+}
+
+
 int
 Accept4(int fd, struct sockaddr *name, socklen_t *nameSize, int flags, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOReadable) && !WaitForConnection(fd, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         int subFD;
 
@@ -152,7 +349,22 @@ Accept4(int fd, struct sockaddr *name, socklen_t *nameSize, int flags, int timeo
             return subFD;
         }
 
-        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOReadable, timeout)) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+#if defined USE_IO_URING
+        if (IORing_IsAvailable(&IORing)) {
+            subFD = DoIORingOperation(IORING_OP_ACCEPT, fd, name, 0, (uintptr_t)nameSize
+                                      , flags | O_NONBLOCK, timeout, ShutdownDraining);
+
+            if (subFD >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return subFD;
+            }
+        }
+#endif
+
+        if (!WaitForConnection(fd, timeout)) {
             return -1;
         }
     }
@@ -184,6 +396,10 @@ Connect(int fd, const struct sockaddr *name, socklen_t nameSize, int timeout)
 ssize_t
 Recv(int fd, void *buffer, size_t bufferSize, int flags, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOReadable) && !WaitForFD(fd, IOReadable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -195,7 +411,22 @@ Recv(int fd, void *buffer, size_t bufferSize, int flags, int timeout)
             return numberOfBytes;
         }
 
-        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOReadable, timeout)) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+#if defined USE_IO_URING
+        if (IORing_IsAvailable(&IORing)) {
+            numberOfBytes = DoIORingOperation(IORING_OP_RECV, fd, buffer, bufferSize, 0, flags
+                                              , timeout, ShutdownExpired);
+
+            if (numberOfBytes >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return numberOfBytes;
+            }
+        }
+#endif
+
+        if (!WaitForFD(fd, IOReadable, timeout)) {
             return -1;
         }
     }
@@ -205,6 +436,10 @@ Recv(int fd, void *buffer, size_t bufferSize, int flags, int timeout)
 ssize_t
 Send(int fd, const void *data, size_t dataSize, int flags, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOWritable) && !WaitForFD(fd, IOWritable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -216,7 +451,22 @@ Send(int fd, const void *data, size_t dataSize, int flags, int timeout)
             return numberOfBytes;
         }
 
-        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOWritable, timeout)) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+#if defined USE_IO_URING
+        if (IORing_IsAvailable(&IORing)) {
+            numberOfBytes = DoIORingOperation(IORING_OP_SEND, fd, (void *)data, dataSize, 0, flags
+                                              , timeout, ShutdownExpired);
+
+            if (numberOfBytes >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return numberOfBytes;
+            }
+        }
+#endif
+
+        if (!WaitForFD(fd, IOWritable, timeout)) {
             return -1;
         }
     }
@@ -227,6 +477,10 @@ ssize_t
 RecvFrom(int fd, void *buffer, size_t bufferSize, int flags, struct sockaddr *name
          , socklen_t *nameSize, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOReadable) && !WaitForFD(fd, IOReadable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -249,6 +503,10 @@ ssize_t
 SendTo(int fd, const void *data, size_t dataSize, int flags, const struct sockaddr *name
        , socklen_t nameSize, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOWritable) && !WaitForFD(fd, IOWritable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -270,6 +528,12 @@ SendTo(int fd, const void *data, size_t dataSize, int flags, const struct sockad
 ssize_t
 RecvMsg(int fd, struct msghdr *message, int flags, int timeout)
 {
+    enum IOCondition ioCondition = (flags & MSG_ERRQUEUE) == 0 ? IOReadable : IOError;
+
+    if (!IOPoller_IsReady(&IOPoller, fd, ioCondition) && !WaitForFD(fd, ioCondition, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -281,7 +545,7 @@ RecvMsg(int fd, struct msghdr *message, int flags, int timeout)
             return numberOfBytes;
         }
 
-        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOReadable, timeout)) {
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, ioCondition, timeout)) {
             return -1;
         }
     }
@@ -291,6 +555,10 @@ RecvMsg(int fd, struct msghdr *message, int flags, int timeout)
 ssize_t
 SendMsg(int fd, const struct msghdr *message, int flags, int timeout)
 {
+    if (!IOPoller_IsReady(&IOPoller, fd, IOWritable) && !WaitForFD(fd, IOWritable, timeout)) {
+        return -1;
+    }
+
     for (;;) {
         ssize_t numberOfBytes;
 
@@ -310,143 +578,743 @@ SendMsg(int fd, const struct msghdr *message, int flags, int timeout)
 
 
 int
-Close(int fd)
+RecvMMsg(int fd, struct mmsghdr *vector, unsigned int vectorLength, int flags, int timeout)
 {
-    IOPoller_ClearWatches(&IOPoller, fd);
-    int result;
+    if (!IOPoller_IsReady(&IOPoller, fd, IOReadable) && !WaitForFD(fd, IOReadable, timeout)) {
+        return -1;
+    }
 
-    do {
-        result = close(fd);
-    } while (result < 0 && errno == EINTR);
+    for (;;) {
+        int numberOfMessages;
 
-    return result;
+        do {
+            numberOfMessages = recvmmsg(fd, vector, vectorLength, flags, NULL);
+        } while (numberOfMessages < 0 && errno == EINTR);
+
+        if (numberOfMessages >= 0) {
+            return numberOfMessages;
+        }
+
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOReadable, timeout)) {
+            return -1;
+        }
+    }
 }
 
 
 int
-GetAddrInfo(const char *hostName, const char *serviceName, const struct addrinfo *hints
-            , struct addrinfo **result)
+SendMMsg(int fd, struct mmsghdr *vector, unsigned int vectorLength, int flags, int timeout)
 {
-    struct {
-        const char *hostName;
-        const char *serviceName;
-        const struct addrinfo *hints;
-        struct addrinfo **result;
-        int errorCode;
-    } context;
+    if (!IOPoller_IsReady(&IOPoller, fd, IOWritable) && !WaitForFD(fd, IOWritable, timeout)) {
+        return -1;
+    }
 
-    context.hostName = hostName;
-    context.serviceName = serviceName;
-    context.hints = hints;
-    context.result = result;
-    DoWork(GetAddrInfoWrapper, (uintptr_t)&context);
-    return context.errorCode;
+    for (;;) {
+        int numberOfMessages;
+
+        do {
+            numberOfMessages = sendmmsg(fd, vector, vectorLength, flags);
+        } while (numberOfMessages < 0 && errno == EINTR);
+
+        if (numberOfMessages >= 0) {
+            return numberOfMessages;
+        }
+
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitForFD(fd, IOWritable, timeout)) {
+            return -1;
+        }
+    }
 }
 
 
-int
-GetNameInfo(const struct sockaddr *name, socklen_t nameSize, char *hostName, socklen_t hostNameSize
-            , char *serviceName, socklen_t serviceNameSize, int flags)
+ssize_t
+SendConnection(int fd, int connectionFD, const void *data, size_t dataSize, int timeout)
 {
-    struct {
-        const struct sockaddr *name;
-        socklen_t nameSize;
-        char *hostName;
-        socklen_t hostNameSize;
-        char *serviceName;
-        socklen_t serviceNameSize;
-        int flags;
-        int errorCode;
-    } context;
+    char tag = ConnectionHandoffTag;
+    struct iovec vector[2] = {
+        {.iov_base = &tag, .iov_len = sizeof tag},
+        {.iov_base = (void *)data, .iov_len = dataSize}
+    };
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    memset(&control, 0, sizeof control);
+    struct msghdr message = {
+        .msg_iov = vector,
+        .msg_iovlen = LENGTH_OF(vector),
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof control.buffer
+    };
+
+    struct cmsghdr *controlMessage = CMSG_FIRSTHDR(&message);
+    controlMessage->cmsg_level = SOL_SOCKET;
+    controlMessage->cmsg_type = SCM_RIGHTS;
+    controlMessage->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(controlMessage), &connectionFD, sizeof(int));
+    ssize_t numberOfBytes = SendMsg(fd, &message, MSG_NOSIGNAL, timeout);
+
+    if (numberOfBytes < 0) {
+        return -1;
+    }
 
-    context.name = name;
-    context.nameSize = nameSize;
-    context.hostName = hostName;
-    context.hostNameSize = hostNameSize;
-    context.serviceName = serviceName;
-    context.serviceNameSize = serviceNameSize;
-    context.flags = flags;
-    DoWork(GetNameInfoWrapper, (uintptr_t)&context);
-    return context.errorCode;
+    if ((size_t)numberOfBytes < sizeof tag + dataSize) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    Close(connectionFD);
+    return dataSize;
 }
 
 
-static bool
-WaitForFD(int fd, enum IOCondition ioCondition, int timeout)
+ssize_t
+ReceiveConnection(int fd, int *connectionFD, void *buffer, size_t bufferSize, int timeout)
 {
-    if (timeout < 0) {
-        struct {
-            struct IOWatch ioWatch;
-            struct Fiber *fiber;
-        } context;
+    char tag;
+    struct iovec vector[2] = {
+        {.iov_base = &tag, .iov_len = sizeof tag},
+        {.iov_base = buffer, .iov_len = bufferSize}
+    };
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr message = {
+        .msg_iov = vector,
+        .msg_iovlen = LENGTH_OF(vector),
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof control.buffer
+    };
+
+    ssize_t numberOfBytes = RecvMsg(fd, &message, MSG_CMSG_CLOEXEC, timeout);
+
+    if (numberOfBytes < 0) {
+        return -1;
+    }
 
-        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    struct cmsghdr *controlMessage = CMSG_FIRSTHDR(&message);
 
-        if (!IOPoller_SetWatch(&IOPoller, &context.ioWatch, fd, ioCondition, (uintptr_t)&context
-                               , WaitForFDCallback1)) {
-            return false;
-        }
+    if (controlMessage == NULL || controlMessage->cmsg_level != SOL_SOCKET
+        || controlMessage->cmsg_type != SCM_RIGHTS
+        || controlMessage->cmsg_len != CMSG_LEN(sizeof(int))) {
+        errno = EPROTO;
+        return -1;
+    }
 
-        Scheduler_SuspendCurrentFiber(&Scheduler);
-    } else {
-        struct {
-            struct IOWatch ioWatch;
-            struct Timeout timeout;
-            struct Fiber *fiber;
-            bool ok;
-            int errorNumber;
-        } context;
+    int receivedFD;
+    memcpy(&receivedFD, CMSG_DATA(controlMessage), sizeof(int));
 
-        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    if (numberOfBytes == 0 || (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        Close(receivedFD);
+        errno = EMSGSIZE;
+        return -1;
+    }
 
-        if (!IOPoller_SetWatch(&IOPoller, &context.ioWatch, fd, ioCondition, (uintptr_t)&context
-                               , WaitForFDCallback2)) {
-            return false;
-        }
+    if (tag != ConnectionHandoffTag) {
+        Close(receivedFD);
+        errno = EPROTO;
+        return -1;
+    }
 
-        if (!Timer_SetTimeout(&Timer, &context.timeout, timeout, (uintptr_t)&context
-                              , WaitForFDCallback3)) {
-            IOPoller_ClearWatch(&IOPoller, &context.ioWatch);
-            return false;
+    *connectionFD = receivedFD;
+    return numberOfBytes - sizeof tag;
+}
+
+
+ssize_t
+SendFile(int outFD, int inFD, off_t *offset, size_t count, int timeout)
+{
+    uint64_t deadline = Timer_GetDeadline(timeout);
+
+    if (!IOPoller_IsReady(&IOPoller, outFD, IOWritable) && !WaitForFD(outFD, IOWritable, timeout)) {
+        return -1;
+    }
+
+    size_t numberOfBytesSent = 0;
+
+    while (numberOfBytesSent < count) {
+        ssize_t numberOfBytes;
+
+        do {
+            numberOfBytes = sendfile(outFD, inFD, offset, count - numberOfBytesSent);
+        } while (numberOfBytes < 0 && errno == EINTR);
+
+        if (numberOfBytes == 0) {
+            break;
         }
 
-        Scheduler_SuspendCurrentFiber(&Scheduler);
+        if (numberOfBytes >= 1) {
+            numberOfBytesSent += numberOfBytes;
+            continue;
+        }
 
-        if (!context.ok) {
-            errno = context.errorNumber;
-            return false;
+        if ((errno != EAGAIN && errno != EWOULDBLOCK)
+            || !WaitForFD(outFD, IOWritable, Timer_ApplyDeadline(&Timer, -1, deadline))) {
+            return numberOfBytesSent == 0 ? -1 : (ssize_t)numberOfBytesSent;
         }
     }
 
-    return true;
+    return numberOfBytesSent;
 }
 
 
-static void
-WaitForFDCallback1(uintptr_t argument)
+int
+Relay(int fd1, int fd2, const struct RelayOptions *options, struct RelayResult *result)
 {
+    if (fd1 < 0 || fd2 < 0) {
+        errno = EBADF;
+        return -1;
+    }
+
+    int pipeSize = options == NULL ? 0 : options->pipeSize;
+    int timeout = options == NULL ? -1 : options->timeout;
+
     struct {
-        struct IOWatch ioWatch;
+        struct RelayDirection direction;
         struct Fiber *fiber;
-    } *context = (void *)argument;
+        bool isDone;
+    } context = {
+        .direction = {.inFD = fd2, .outFD = fd1, .pipeSize = pipeSize, .timeout = timeout},
+        .fiber = NULL,
+        .isDone = false
+    };
+
+    if (!Scheduler_AddFiber(&Scheduler, RelayDataWrapper, (uintptr_t)&context)) {
+        return -1;
+    }
 
-    IOPoller_ClearWatch(&IOPoller, &context->ioWatch);
-    Scheduler_ResumeFiber(&Scheduler, context->fiber);
-}
+    struct RelayDirection direction = {
+        .inFD = fd1,
+        .outFD = fd2,
+        .pipeSize = pipeSize,
+        .timeout = timeout
+    };
 
+    RelayData((uintptr_t)&direction);
 
-static void
-WaitForFDCallback2(uintptr_t argument)
-{
-    struct {
-        struct IOWatch ioWatch;
-        struct Timeout timeout;
+    if (!context.isDone) {
+        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+    }
+
+    if (result != NULL) {
+        result->numberOfBytes[0] = direction.numberOfBytes;
+        result->numberOfBytes[1] = context.direction.numberOfBytes;
+        result->isHalfClosed[0] = direction.isHalfClosed;
+        result->isHalfClosed[1] = context.direction.isHalfClosed;
+        result->errorNumber[0] = direction.errorNumber;
+        result->errorNumber[1] = context.direction.errorNumber;
+    }
+
+    if (direction.errorNumber != 0 || context.direction.errorNumber != 0) {
+        errno = direction.errorNumber != 0 ? direction.errorNumber
+                                           : context.direction.errorNumber;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int
+SetUDPGRO(int fd, int enabled)
+{
+    return setsockopt(fd, SOL_UDP, UDP_GRO, &enabled, sizeof enabled);
+}
+
+
+ssize_t
+SendSegments(int fd, const void *data, size_t dataSize, size_t segmentSize
+             , const struct sockaddr *name, socklen_t nameSize, int timeout)
+{
+    if (segmentSize == 0 || segmentSize > UINT16_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct iovec vector = {.iov_base = (void *)data, .iov_len = dataSize};
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(uint16_t))];
+    } control;
+
+    memset(&control, 0, sizeof control);
+    struct msghdr message = {
+        .msg_name = (void *)name,
+        .msg_namelen = nameSize,
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof control.buffer
+    };
+
+    struct cmsghdr *controlMessage = CMSG_FIRSTHDR(&message);
+    controlMessage->cmsg_level = SOL_UDP;
+    controlMessage->cmsg_type = UDP_SEGMENT;
+    controlMessage->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t temp = segmentSize;
+    memcpy(CMSG_DATA(controlMessage), &temp, sizeof(uint16_t));
+    return SendMsg(fd, &message, 0, timeout);
+}
+
+
+ssize_t
+RecvSegments(int fd, void *buffer, size_t bufferSize, size_t *segmentSize, struct sockaddr *name
+             , socklen_t *nameSize, int timeout)
+{
+    if (segmentSize == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct iovec vector = {.iov_base = buffer, .iov_len = bufferSize};
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct in6_pktinfo))
+                    + CMSG_SPACE(3 * sizeof(struct timespec)) + CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr message = {
+        .msg_name = name,
+        .msg_namelen = nameSize == NULL ? 0 : *nameSize,
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof control.buffer
+    };
+
+    ssize_t numberOfBytes = RecvMsg(fd, &message, 0, timeout);
+
+    if (numberOfBytes < 0) {
+        return -1;
+    }
+
+    if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    if (nameSize != NULL) {
+        *nameSize = message.msg_namelen;
+    }
+
+    *segmentSize = numberOfBytes;
+    struct cmsghdr *controlMessage;
+
+    for (controlMessage = CMSG_FIRSTHDR(&message); controlMessage != NULL
+         ; controlMessage = CMSG_NXTHDR(&message, controlMessage)) {
+        if (controlMessage->cmsg_level == SOL_UDP && controlMessage->cmsg_type == UDP_GRO) {
+            int temp;
+            memcpy(&temp, CMSG_DATA(controlMessage), sizeof(int));
+
+            if (temp >= 1) {
+                *segmentSize = temp;
+            }
+        }
+    }
+
+    return numberOfBytes;
+}
+
+
+int
+SplitSegments(void *buffer, size_t bufferSize, size_t segmentSize, struct iovec *vector
+              , int vectorLength)
+{
+    if (segmentSize == 0 || vectorLength < 0 || (vector == NULL && vectorLength >= 1)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t totalNumberOfSegments = bufferSize / segmentSize + (bufferSize % segmentSize != 0);
+
+    if (totalNumberOfSegments > INT_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    char *segment = buffer;
+    int numberOfSegments = 0;
+
+    while (bufferSize >= 1 && numberOfSegments < vectorLength) {
+        size_t size = bufferSize < segmentSize ? bufferSize : segmentSize;
+        vector[numberOfSegments].iov_base = segment;
+        vector[numberOfSegments].iov_len = size;
+        ++numberOfSegments;
+        segment += size;
+        bufferSize -= size;
+    }
+
+    return totalNumberOfSegments;
+}
+
+
+int
+RegisterFD(int fd)
+{
+    if (fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (!IOPoller_RegisterFD(&IOPoller, fd)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int
+Close(int fd)
+{
+    IOPoller_ClearWatches(&IOPoller, fd);
+    int result;
+
+    do {
+        result = close(fd);
+    } while (result < 0 && errno == EINTR);
+
+    return result;
+}
+
+
+int
+Open(const char *path, int flags, mode_t mode)
+{
+    struct {
+        const char *path;
+        int flags;
+        mode_t mode;
+        int result;
+        int errorNumber;
+    } context;
+
+    context.path = path;
+    context.flags = flags;
+    context.mode = mode;
+    DoWork(OpenWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+ssize_t
+PRead(int fd, void *buffer, size_t bufferSize, off_t offset)
+{
+    struct {
+        int fd;
+        void *buffer;
+        size_t bufferSize;
+        off_t offset;
+        ssize_t result;
+        int errorNumber;
+    } context;
+
+    struct iovec vector = {.iov_base = buffer, .iov_len = bufferSize};
+    ssize_t numberOfBytes = TryPReadV(fd, &vector, 1, offset);
+
+    if (numberOfBytes >= 0 || errno != EAGAIN) {
+        return numberOfBytes;
+    }
+
+    context.fd = fd;
+    context.buffer = buffer;
+    context.bufferSize = bufferSize;
+    context.offset = offset;
+    DoWork(PReadWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+ssize_t
+PWrite(int fd, const void *data, size_t dataSize, off_t offset)
+{
+    struct {
+        int fd;
+        const void *data;
+        size_t dataSize;
+        off_t offset;
+        ssize_t result;
+        int errorNumber;
+    } context;
+
+    context.fd = fd;
+    context.data = data;
+    context.dataSize = dataSize;
+    context.offset = offset;
+    DoWork(PWriteWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+ssize_t
+PReadV(int fd, const struct iovec *vector, int vectorLength, off_t offset)
+{
+    struct {
+        int fd;
+        const struct iovec *vector;
+        int vectorLength;
+        off_t offset;
+        ssize_t result;
+        int errorNumber;
+    } context;
+
+    ssize_t numberOfBytes = TryPReadV(fd, vector, vectorLength, offset);
+
+    if (numberOfBytes >= 0 || errno != EAGAIN) {
+        return numberOfBytes;
+    }
+
+    context.fd = fd;
+    context.vector = vector;
+    context.vectorLength = vectorLength;
+    context.offset = offset;
+    DoWork(PReadVWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+bool
+GetFileReadMetrics(struct FileReadMetrics *fileReadMetrics)
+{
+    if (fileReadMetrics == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    fileReadMetrics->numberOfInlineReads = NumberOfInlineFileReads;
+    fileReadMetrics->numberOfOffloadedReads = NumberOfOffloadedFileReads;
+    return true;
+}
+
+
+int
+Fsync(int fd)
+{
+    struct {
+        int fd;
+        int result;
+        int errorNumber;
+    } context;
+
+    context.fd = fd;
+    DoWork(FsyncWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+int
+FStat(int fd, struct stat *stat)
+{
+    struct {
+        int fd;
+        struct stat *stat;
+        int result;
+        int errorNumber;
+    } context;
+
+    context.fd = fd;
+    context.stat = stat;
+    DoWork(FStatWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+int
+Unlink(const char *path)
+{
+    struct {
+        const char *path;
+        int result;
+        int errorNumber;
+    } context;
+
+    context.path = path;
+    DoWork(UnlinkWrapper, (uintptr_t)&context);
+    errno = context.errorNumber;
+    return context.result;
+}
+
+
+int
+GetAddrInfo(const char *hostName, const char *serviceName, const struct addrinfo *hints
+            , struct addrinfo **result)
+{
+    struct {
+        const char *hostName;
+        const char *serviceName;
+        const struct addrinfo *hints;
+        struct addrinfo **result;
+        int errorCode;
+    } context;
+
+    context.hostName = hostName;
+    context.serviceName = serviceName;
+    context.hints = hints;
+    context.result = result;
+    DoWork(GetAddrInfoWrapper, (uintptr_t)&context);
+    return context.errorCode;
+}
+
+
+int
+GetNameInfo(const struct sockaddr *name, socklen_t nameSize, char *hostName, socklen_t hostNameSize
+            , char *serviceName, socklen_t serviceNameSize, int flags)
+{
+    struct {
+        const struct sockaddr *name;
+        socklen_t nameSize;
+        char *hostName;
+        socklen_t hostNameSize;
+        char *serviceName;
+        socklen_t serviceNameSize;
+        int flags;
+        int errorCode;
+    } context;
+
+    context.name = name;
+    context.nameSize = nameSize;
+    context.hostName = hostName;
+    context.hostNameSize = hostNameSize;
+    context.serviceName = serviceName;
+    context.serviceNameSize = serviceNameSize;
+    context.flags = flags;
+    DoWork(GetNameInfoWrapper, (uintptr_t)&context);
+    return context.errorCode;
+}
+
+
+static bool
+WaitForFD(int fd, enum IOCondition ioCondition, int timeout)
+{
+    return WaitForFDOrShutdown(fd, ioCondition, timeout, ShutdownExpired);
+}
+
+
+static bool
+WaitForConnection(int fd, int timeout)
+{
+    return WaitForFDOrShutdown(fd, IOReadable, timeout, ShutdownDraining);
+}
+
+
+static bool
+WaitForFDOrShutdown(int fd, enum IOCondition ioCondition, int timeout
+                    , enum ShutdownState shutdownState)
+{
+    if (Shutdown_GetState(&Shutdown) >= shutdownState) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    IOPoller_ClearReady(&IOPoller, fd, ioCondition);
+    timeout = Timer_ApplyDeadline(&Timer, timeout
+                                  , Fiber_GetDeadline(Scheduler_GetCurrentFiber(&Scheduler)));
+
+    if (timeout < 0) {
+        struct {
+            struct IOWatch ioWatch;
+            struct ShutdownWatch shutdownWatch;
+            struct Fiber *fiber;
+            bool ok;
+        } context;
+
+        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+
+        if (!IOPoller_SetWatch(&IOPoller, &context.ioWatch, fd, ioCondition, (uintptr_t)&context
+                               , WaitForFDCallback1)) {
+            return false;
+        }
+
+        Shutdown_SetWatch(&Shutdown, &context.shutdownWatch, shutdownState, (uintptr_t)&context
+                          , WaitForFDCallback4);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+
+        if (!context.ok) {
+            errno = ECANCELED;
+            return false;
+        }
+    } else {
+        struct {
+            struct IOWatch ioWatch;
+            struct ShutdownWatch shutdownWatch;
+            struct Timeout timeout;
+            struct Fiber *fiber;
+            bool ok;
+            int errorNumber;
+        } context;
+
+        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+
+        if (!IOPoller_SetWatch(&IOPoller, &context.ioWatch, fd, ioCondition, (uintptr_t)&context
+                               , WaitForFDCallback2)) {
+            return false;
+        }
+
+        if (!Timer_SetTimeout(&Timer, &context.timeout, timeout, (uintptr_t)&context
+                              , WaitForFDCallback3)) {
+            IOPoller_ClearWatch(&IOPoller, &context.ioWatch);
+            return false;
+        }
+
+        Shutdown_SetWatch(&Shutdown, &context.shutdownWatch, shutdownState, (uintptr_t)&context
+                          , WaitForFDCallback5);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+
+        if (!context.ok) {
+            errno = context.errorNumber;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void
+WaitForFDCallback1(uintptr_t argument)
+{
+    struct {
+        struct IOWatch ioWatch;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } *context = (void *)argument;
+
+    IOPoller_ClearWatch(&IOPoller, &context->ioWatch);
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
+    context->ok = true;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+WaitForFDCallback2(uintptr_t argument)
+{
+    struct {
+        struct IOWatch ioWatch;
+        struct ShutdownWatch shutdownWatch;
+        struct Timeout timeout;
         struct Fiber *fiber;
         bool ok;
         int errorNumber;
     } *context = (void *)argument;
 
     IOPoller_ClearWatch(&IOPoller, &context->ioWatch);
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
     Timer_ClearTimeout(&Timer, &context->timeout);
     context->ok = true;
     Scheduler_ResumeFiber(&Scheduler, context->fiber);
@@ -457,20 +1325,202 @@ static void
 WaitForFDCallback3(uintptr_t argument)
 {
     struct {
-        struct Fiber *fiber;
         struct IOWatch ioWatch;
+        struct ShutdownWatch shutdownWatch;
         struct Timeout timeout;
+        struct Fiber *fiber;
         bool ok;
         int errorNumber;
     } *context = (void *)argument;
 
     IOPoller_ClearWatch(&IOPoller, &context->ioWatch);
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
     context->ok = false;
     context->errorNumber = EINTR;
     Scheduler_ResumeFiber(&Scheduler, context->fiber);
 }
 
 
+static void
+WaitForFDCallback4(uintptr_t argument)
+{
+    struct {
+        struct IOWatch ioWatch;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } *context = (void *)argument;
+
+    IOPoller_ClearWatch(&IOPoller, &context->ioWatch);
+    context->ok = false;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+WaitForFDCallback5(uintptr_t argument)
+{
+    struct {
+        struct IOWatch ioWatch;
+        struct ShutdownWatch shutdownWatch;
+        struct Timeout timeout;
+        struct Fiber *fiber;
+        bool ok;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    IOPoller_ClearWatch(&IOPoller, &context->ioWatch);
+    Timer_ClearTimeout(&Timer, &context->timeout);
+    context->ok = false;
+    context->errorNumber = ECANCELED;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+#if defined USE_IO_URING
+static ssize_t
+DoIORingOperation(int opcode, int fd, void *address, unsigned int length, uint64_t offset
+                  , unsigned int flags, int timeout, enum ShutdownState shutdownState)
+{
+    if (Shutdown_GetState(&Shutdown) >= shutdownState) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    timeout = Timer_ApplyDeadline(&Timer, timeout
+                                  , Fiber_GetDeadline(Scheduler_GetCurrentFiber(&Scheduler)));
+
+    if (!IORing_Reserve(&IORing, timeout < 0 ? 1 : 2)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    struct {
+        struct IOCompletion completion;
+        struct ShutdownWatch shutdownWatch;
+        struct __kernel_timespec timeout;
+        struct Fiber *fiber;
+        bool isCanceled;
+    } context;
+
+    struct io_uring_sqe *sqe = IORing_AddOperation(&IORing, opcode, fd, &context.completion
+                                                   , (uintptr_t)&context
+                                                   , DoIORingOperationCallback1);
+    sqe->addr = (uintptr_t)address;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->rw_flags = flags;
+
+    if (timeout >= 0) {
+        sqe->flags |= IOSQE_IO_LINK;
+        context.timeout.tv_sec = timeout / 1000;
+        context.timeout.tv_nsec = timeout % 1000 * 1000000;
+        sqe = IORing_AddOperation(&IORing, IORING_OP_LINK_TIMEOUT, -1, NULL, 0, NULL);
+        sqe->addr = (uintptr_t)&context.timeout;
+        sqe->len = 1;
+    }
+
+    context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    context.isCanceled = false;
+    Shutdown_SetWatch(&Shutdown, &context.shutdownWatch, shutdownState, (uintptr_t)&context
+                      , DoIORingOperationCallback2);
+    Scheduler_SuspendCurrentFiber(&Scheduler);
+
+    if (context.completion.result >= 0) {
+        return context.completion.result;
+    }
+
+    if (context.isCanceled) {
+        errno = ECANCELED;
+    } else if (context.completion.result == -ECANCELED && timeout >= 0) {
+        errno = EINTR;
+    } else {
+        errno = -context.completion.result;
+    }
+
+    return -1;
+}
+
+
+static void
+DoIORingOperationCallback1(uintptr_t argument)
+{
+    struct {
+        struct IOCompletion completion;
+        struct ShutdownWatch shutdownWatch;
+        struct __kernel_timespec timeout;
+        struct Fiber *fiber;
+        bool isCanceled;
+    } *context = (void *)argument;
+
+    if (!context->isCanceled) {
+        Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
+    }
+
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+DoIORingOperationCallback2(uintptr_t argument)
+{
+    struct {
+        struct IOCompletion completion;
+        struct ShutdownWatch shutdownWatch;
+        struct __kernel_timespec timeout;
+        struct Fiber *fiber;
+        bool isCanceled;
+    } *context = (void *)argument;
+
+    context->isCanceled = true;
+    IORing_Cancel(&IORing, &context->completion);
+}
+#endif
+
+
+static ssize_t
+TryPReadV(int fd, const struct iovec *vector, int vectorLength, off_t offset)
+{
+    if (!NoWaitReadIsUnsupported) {
+        ssize_t numberOfBytes;
+
+        do {
+            numberOfBytes = preadv2(fd, vector, vectorLength, offset, RWF_NOWAIT);
+        } while (numberOfBytes < 0 && errno == EINTR);
+
+        if (numberOfBytes >= 1) {
+            ++NumberOfInlineFileReads;
+            return numberOfBytes;
+        }
+
+        if (numberOfBytes == 0) {
+            size_t bufferSize = 0;
+            int i;
+
+            for (i = 0; i < vectorLength; ++i) {
+                bufferSize += vector[i].iov_len;
+            }
+
+            struct stat stat;
+
+            if (bufferSize == 0 || (fstat(fd, &stat) == 0 && S_ISREG(stat.st_mode)
+                                    && offset >= stat.st_size)) {
+                ++NumberOfInlineFileReads;
+                return 0;
+            }
+        } else if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            NoWaitReadIsUnsupported = true;
+        } else if (errno != EAGAIN) {
+            return -1;
+        }
+    }
+
+    ++NumberOfOffloadedFileReads;
+    errno = EAGAIN;
+    return -1;
+}
+
+
 static void
 DoWork(void (*function)(uintptr_t), uintptr_t argument)
 {
@@ -488,6 +1538,234 @@ DoWorkCallback(uintptr_t argument)
 }
 
 
+static void
+RelayData(uintptr_t argument)
+{
+    struct RelayDirection *direction = (struct RelayDirection *)argument;
+    int fds[2];
+
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0) {
+        direction->errorNumber = errno;
+    } else {
+        if (direction->pipeSize >= 1) {
+            fcntl(fds[1], F_SETPIPE_SZ, direction->pipeSize);
+        }
+
+        int pipeSize = fcntl(fds[1], F_GETPIPE_SZ);
+
+        if (pipeSize < 1) {
+            pipeSize = 65536;
+        }
+
+        for (;;) {
+            ssize_t numberOfBytes;
+
+            do {
+                numberOfBytes = splice(direction->inFD, NULL, fds[1], NULL, pipeSize
+                                       , SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            } while (numberOfBytes < 0 && errno == EINTR);
+
+            if (numberOfBytes == 0) {
+                break;
+            }
+
+            if (numberOfBytes < 0) {
+                if ((errno != EAGAIN && errno != EWOULDBLOCK)
+                    || !WaitForFD(direction->inFD, IOReadable, direction->timeout)) {
+                    direction->errorNumber = errno;
+                    break;
+                }
+
+                continue;
+            }
+
+            size_t numberOfPendingBytes = numberOfBytes;
+
+            while (numberOfPendingBytes >= 1) {
+                do {
+                    numberOfBytes = splice(fds[0], NULL, direction->outFD, NULL
+                                           , numberOfPendingBytes
+                                           , SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                } while (numberOfBytes < 0 && errno == EINTR);
+
+                if (numberOfBytes < 0) {
+                    if ((errno != EAGAIN && errno != EWOULDBLOCK)
+                        || !WaitForFD(direction->outFD, IOWritable, direction->timeout)) {
+                        direction->errorNumber = errno;
+                        break;
+                    }
+
+                    continue;
+                }
+
+                numberOfPendingBytes -= numberOfBytes;
+                direction->numberOfBytes += numberOfBytes;
+            }
+
+            if (direction->errorNumber != 0) {
+                break;
+            }
+        }
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    if (direction->errorNumber == 0) {
+        shutdown(direction->outFD, SHUT_WR);
+        direction->isHalfClosed = true;
+    } else {
+        shutdown(direction->inFD, SHUT_RDWR);
+        shutdown(direction->outFD, SHUT_RDWR);
+    }
+}
+
+
+static void
+RelayDataWrapper(uintptr_t argument)
+{
+    struct {
+        struct RelayDirection direction;
+        struct Fiber *fiber;
+        bool isDone;
+    } *context = (void *)argument;
+
+    RelayData((uintptr_t)&context->direction);
+    context->isDone = true;
+
+    if (context->fiber != NULL) {
+        Scheduler_ResumeFiber(&Scheduler, context->fiber);
+    }
+}
+
+
+static void
+OpenWrapper(uintptr_t argument)
+{
+    struct {
+        const char *path;
+        int flags;
+        mode_t mode;
+        int result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    do {
+        context->result = open(context->path, context->flags, context->mode);
+    } while (context->result < 0 && errno == EINTR);
+
+    context->errorNumber = errno;
+}
+
+
+static void
+PReadWrapper(uintptr_t argument)
+{
+    struct {
+        int fd;
+        void *buffer;
+        size_t bufferSize;
+        off_t offset;
+        ssize_t result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    do {
+        context->result = pread(context->fd, context->buffer, context->bufferSize
+                                , context->offset);
+    } while (context->result < 0 && errno == EINTR);
+
+    context->errorNumber = errno;
+}
+
+
+static void
+PWriteWrapper(uintptr_t argument)
+{
+    struct {
+        int fd;
+        const void *data;
+        size_t dataSize;
+        off_t offset;
+        ssize_t result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    do {
+        context->result = pwrite(context->fd, context->data, context->dataSize, context->offset);
+    } while (context->result < 0 && errno == EINTR);
+
+    context->errorNumber = errno;
+}
+
+
+static void
+PReadVWrapper(uintptr_t argument)
+{
+    struct {
+        int fd;
+        const struct iovec *vector;
+        int vectorLength;
+        off_t offset;
+        ssize_t result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    do {
+        context->result = preadv(context->fd, context->vector, context->vectorLength
+                                 , context->offset);
+    } while (context->result < 0 && errno == EINTR);
+
+    context->errorNumber = errno;
+}
+
+
+static void
+FsyncWrapper(uintptr_t argument)
+{
+    struct {
+        int fd;
+        int result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    do {
+        context->result = fsync(context->fd);
+    } while (context->result < 0 && errno == EINTR);
+
+    context->errorNumber = errno;
+}
+
+
+static void
+FStatWrapper(uintptr_t argument)
+{
+    struct {
+        int fd;
+        struct stat *stat;
+        int result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    context->result = fstat(context->fd, context->stat);
+    context->errorNumber = errno;
+}
+
+
+static void
+UnlinkWrapper(uintptr_t argument)
+{
+    struct {
+        const char *path;
+        int result;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    context->result = unlink(context->path);
+    context->errorNumber = errno;
+}
+
+
 static void
 GetAddrInfoWrapper(uintptr_t argument)
 {
@@ -7,6 +7,7 @@
 
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <stddef.h>
 #include <assert.h>
@@ -24,18 +25,28 @@ struct IOEvent
     int fd;
     uint32_t flags;
     uint32_t pendingFlags;
-    struct ListItem watchListHeads[2];
+    bool isEdgeTriggered;
+    uint32_t readyFlags;
+    struct ListItem watchListHeads[3];
 };
 
 
+static struct IOEvent *IOPoller_GetEvent(struct IOPoller *, int);
+static struct IOEvent *IOPoller_FindEvent(const struct IOPoller *, int);
+static int IOPoller_BusyPoll(struct IOPoller *, struct epoll_event *, int, int *);
+
+static uint64_t GetTime(void);
+
 static int xepoll_create1(int);
 static void xclose(int);
 static void xepoll_ctl(int, int, int, struct epoll_event *);
+static void xclock_gettime(clockid_t, struct timespec *);
 
 
-static const uint32_t IOEventFlags[2] = {
+static const uint32_t IOEventFlags[3] = {
     [IOReadable] = EPOLLIN,
-    [IOWritable] = EPOLLOUT
+    [IOWritable] = EPOLLOUT,
+    [IOError] = EPOLLERR
 };
 
 
@@ -47,6 +58,8 @@ IOPoller_Initialize(struct IOPoller *self)
     Vector_Initialize(&self->eventVector, sizeof(struct IOEvent *));
     MemoryPool_Initialize(&self->eventMemoryPool, sizeof(struct IOEvent));
     List_Initialize(&self->dirtyEventListHead);
+    self->maxBusyPollTime = 0;
+    self->busyPollTime = 0;
 }
 
 
@@ -67,32 +80,13 @@ IOPoller_SetWatch(struct IOPoller *self, struct IOWatch *watch, int fd, enum IOC
     assert(self != NULL);
     assert(watch != NULL);
     assert(fd >= 0);
-    assert(condition == IOReadable || condition == IOWritable);
+    assert(condition == IOReadable || condition == IOWritable || condition == IOError);
     assert(callback != NULL);
 
-    if (fd >= Vector_GetLength(&self->eventVector)) {
-        if (!Vector_SetLength(&self->eventVector, fd + 1, true)) {
-            return false;
-        }
-    }
-
-    struct IOEvent **events = Vector_GetElements(&self->eventVector);
-    struct IOEvent *event = events[fd];
+    struct IOEvent *event = IOPoller_GetEvent(self, fd);
 
     if (event == NULL) {
-        event = MemoryPool_AllocateBlock(&self->eventMemoryPool);
-
-        if (event == NULL) {
-            return false;
-        }
-
-        event->fd = fd;
-        event->flags = 0;
-        event->pendingFlags = 0;
-        List_Initialize(&event->watchListHeads[0]);
-        List_Initialize(&event->watchListHeads[1]);
-        List_Initialize(&event->listItem);
-        events[fd] = event;
+        return false;
     }
 
     watch->condition = condition;
@@ -100,7 +94,7 @@ IOPoller_SetWatch(struct IOPoller *self, struct IOWatch *watch, int fd, enum IOC
     watch->callback = callback;
     List_InsertBack(&event->watchListHeads[condition], &watch->listItem);
 
-    if ((event->pendingFlags & IOEventFlags[condition]) == 0) {
+    if (!event->isEdgeTriggered && (event->pendingFlags & IOEventFlags[condition]) == 0) {
         event->pendingFlags |= IOEventFlags[condition];
 
         if (List_IsEmpty(&event->listItem)) {
@@ -123,6 +117,11 @@ IOPoller_ClearWatch(struct IOPoller *self, const struct IOWatch *watch)
         enum IOCondition condition = watch->condition;
         struct IOEvent *event = CONTAINER_OF(ListItem_GetPrev(&watch->listItem), struct IOEvent
                                              , watchListHeads[condition]);
+
+        if (event->isEdgeTriggered) {
+            return;
+        }
+
         event->pendingFlags &= ~IOEventFlags[condition];
 
         if (List_IsEmpty(&event->listItem)) {
@@ -151,7 +150,9 @@ IOPoller_ClearWatches(struct IOPoller *self, int fd)
 
     List_Initialize(&event->watchListHeads[0]);
     List_Initialize(&event->watchListHeads[1]);
+    List_Initialize(&event->watchListHeads[2]);
     event->pendingFlags = 0;
+    event->isEdgeTriggered = false;
 
     if (List_IsEmpty(&event->listItem)) {
         List_InsertBack(&self->dirtyEventListHead, &event->listItem);
@@ -165,6 +166,76 @@ IOPoller_ClearWatches(struct IOPoller *self, int fd)
 }
 
 
+bool
+IOPoller_RegisterFD(struct IOPoller *self, int fd)
+{
+    assert(self != NULL);
+    assert(fd >= 0);
+    struct IOEvent *event = IOPoller_GetEvent(self, fd);
+
+    if (event == NULL) {
+        return false;
+    }
+
+    if (event->isEdgeTriggered) {
+        return true;
+    }
+
+    event->pendingFlags = IOEventFlags[IOReadable] | IOEventFlags[IOWritable] | EPOLLRDHUP
+                          | EPOLLET;
+    event->isEdgeTriggered = true;
+    event->readyFlags = IOEventFlags[IOReadable] | IOEventFlags[IOWritable]
+                        | IOEventFlags[IOError];
+
+    if (List_IsEmpty(&event->listItem)) {
+        List_InsertBack(&self->dirtyEventListHead, &event->listItem);
+    }
+
+    return true;
+}
+
+
+bool
+IOPoller_IsReady(const struct IOPoller *self, int fd, enum IOCondition condition)
+{
+    assert(self != NULL);
+    assert(condition == IOReadable || condition == IOWritable || condition == IOError);
+    struct IOEvent *event = IOPoller_FindEvent(self, fd);
+
+    if (event == NULL || !event->isEdgeTriggered) {
+        return true;
+    }
+
+    return (event->readyFlags & IOEventFlags[condition]) != 0;
+}
+
+
+void
+IOPoller_ClearReady(struct IOPoller *self, int fd, enum IOCondition condition)
+{
+    assert(self != NULL);
+    assert(fd >= 0);
+    assert(condition == IOReadable || condition == IOWritable || condition == IOError);
+    struct IOEvent *event = IOPoller_FindEvent(self, fd);
+
+    if (event == NULL || !event->isEdgeTriggered) {
+        return;
+    }
+
+    event->readyFlags &= ~IOEventFlags[condition];
+}
+
+
+void
+IOPoller_SetBusyPolling(struct IOPoller *self, int maxBusyPollTime)
+{
+    assert(self != NULL);
+    assert(maxBusyPollTime >= 0);
+    self->maxBusyPollTime = maxBusyPollTime;
+    self->busyPollTime = maxBusyPollTime;
+}
+
+
 bool
 IOPoller_Tick(struct IOPoller *self, int timeout, struct Async *async)
 {
@@ -210,7 +281,11 @@ IOPoller_Tick(struct IOPoller *self, int timeout, struct Async *async)
     }
 
     struct epoll_event evs[8192];
-    int n = epoll_wait(self->fd, evs, LENGTH_OF(evs), timeout);
+    int n = IOPoller_BusyPoll(self, evs, LENGTH_OF(evs), &timeout);
+
+    if (n == 0) {
+        n = epoll_wait(self->fd, evs, LENGTH_OF(evs), timeout);
+    }
 
     if (n < 0) {
         if (errno == EINTR) {
@@ -225,7 +300,8 @@ IOPoller_Tick(struct IOPoller *self, int timeout, struct Async *async)
     for (i = 0; i < n; ++i) {
         struct IOEvent *event = evs[i].data.ptr;
 
-        if ((evs[i].events & (IOEventFlags[0] | EPOLLERR | EPOLLHUP)) != 0) {
+        if ((evs[i].events & (IOEventFlags[0] | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) != 0) {
+            event->readyFlags |= IOEventFlags[0];
             struct ListItem *watchListItem;
 
             FOR_EACH_LIST_ITEM(watchListItem, &event->watchListHeads[0]) {
@@ -238,6 +314,7 @@ IOPoller_Tick(struct IOPoller *self, int timeout, struct Async *async)
         }
 
         if ((evs[i].events & (IOEventFlags[1] | EPOLLERR | EPOLLHUP)) != 0) {
+            event->readyFlags |= IOEventFlags[1];
             struct ListItem *watchListItem;
 
             FOR_EACH_LIST_ITEM(watchListItem, &event->watchListHeads[1]) {
@@ -248,12 +325,125 @@ IOPoller_Tick(struct IOPoller *self, int timeout, struct Async *async)
                 }
             }
         }
+
+        if ((evs[i].events & (IOEventFlags[2] | EPOLLHUP)) != 0) {
+            event->readyFlags |= IOEventFlags[2];
+            struct ListItem *watchListItem;
+
+            FOR_EACH_LIST_ITEM(watchListItem, &event->watchListHeads[2]) {
+                struct IOWatch *watch = CONTAINER_OF(watchListItem, struct IOWatch, listItem);
+
+                if (!Async_AddCall(async, watch->callback, watch->data)) {
+                    return false;
+                }
+            }
+        }
     }
 
     return true;
 }
 
 
+static struct IOEvent *
+IOPoller_GetEvent(struct IOPoller *self, int fd)
+{
+    if (fd >= Vector_GetLength(&self->eventVector)) {
+        if (!Vector_SetLength(&self->eventVector, fd + 1, true)) {
+            return NULL;
+        }
+    }
+
+    struct IOEvent **events = Vector_GetElements(&self->eventVector);
+    struct IOEvent *event = events[fd];
+
+    if (event == NULL) {
+        event = MemoryPool_AllocateBlock(&self->eventMemoryPool);
+
+        if (event == NULL) {
+            return NULL;
+        }
+
+        event->fd = fd;
+        event->flags = 0;
+        event->pendingFlags = 0;
+        event->isEdgeTriggered = false;
+        List_Initialize(&event->watchListHeads[0]);
+        List_Initialize(&event->watchListHeads[1]);
+        List_Initialize(&event->watchListHeads[2]);
+        List_Initialize(&event->listItem);
+        events[fd] = event;
+    }
+
+    return event;
+}
+
+
+static struct IOEvent *
+IOPoller_FindEvent(const struct IOPoller *self, int fd)
+{
+    if (fd < 0 || fd >= Vector_GetLength(&self->eventVector)) {
+        return NULL;
+    }
+
+    struct IOEvent **events = Vector_GetElements(&self->eventVector);
+    return events[fd];
+}
+
+
+static int
+IOPoller_BusyPoll(struct IOPoller *self, struct epoll_event *evs, int maxNumberOfEvs
+                  , int *timeout)
+{
+    if (self->busyPollTime == 0 || *timeout == 0) {
+        return 0;
+    }
+
+    uint64_t duration = self->busyPollTime;
+
+    if (*timeout >= 0 && (uint64_t)*timeout * 1000 < duration) {
+        duration = (uint64_t)*timeout * 1000;
+    }
+
+    uint64_t startTime = GetTime();
+    uint64_t elapsedTime;
+
+    do {
+        int n = epoll_wait(self->fd, evs, maxNumberOfEvs, 0);
+
+        if (n != 0) {
+            if (n >= 1 && self->busyPollTime < self->maxBusyPollTime) {
+                self->busyPollTime = self->busyPollTime <= self->maxBusyPollTime / 2
+                                     ? 2 * self->busyPollTime : self->maxBusyPollTime;
+            }
+
+            return n;
+        }
+
+        elapsedTime = GetTime() - startTime;
+    } while (elapsedTime < duration);
+
+    if (self->busyPollTime > self->maxBusyPollTime / 16 + 1) {
+        self->busyPollTime /= 2;
+    }
+
+    if (*timeout >= 1) {
+        *timeout = elapsedTime / 1000 < (uint64_t)*timeout ? *timeout - (int)(elapsedTime / 1000)
+                                                           : 0;
+    }
+
+    return 0;
+}
+
+
+static uint64_t
+GetTime(void)
+{
+    struct timespec t;
+    xclock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+
 static int
 xepoll_create1(int flags)
 {
@@ -289,3 +479,12 @@ xepoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
         LOG_FATAL_ERROR("`epoll_ctl()` failed: %s", strerror(errno));
     }
 }
+
+
+static void
+xclock_gettime(clockid_t clock_id, struct timespec *tp)
+{
+    if (clock_gettime(clock_id, tp) < 0) {
+        LOG_FATAL_ERROR("`clock_gettime()` failed: %s", strerror(errno));
+    }
+}
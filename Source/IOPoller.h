@@ -17,7 +17,8 @@
 enum IOCondition
 {
     IOReadable,
-    IOWritable
+    IOWritable,
+    IOError
 };
 
 
@@ -30,6 +31,8 @@ struct IOPoller
     struct Vector eventVector;
     struct MemoryPool eventMemoryPool;
     struct ListItem dirtyEventListHead;
+    int maxBusyPollTime;
+    int busyPollTime;
 };
 
 
@@ -48,4 +51,8 @@ bool IOPoller_SetWatch(struct IOPoller *, struct IOWatch *, int, enum IOConditio
                        , void (*)(uintptr_t));
 void IOPoller_ClearWatch(struct IOPoller *, const struct IOWatch *);
 void IOPoller_ClearWatches(struct IOPoller *, int);
+bool IOPoller_RegisterFD(struct IOPoller *, int);
+bool IOPoller_IsReady(const struct IOPoller *, int, enum IOCondition);
+void IOPoller_ClearReady(struct IOPoller *, int, enum IOCondition);
+void IOPoller_SetBusyPolling(struct IOPoller *, int);
 bool IOPoller_Tick(struct IOPoller *, int, struct Async *);
@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "IORing.h"
+
+#if defined USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+
+#include "Logging.h"
+
+
+#define IO_RING_LENGTH 256
+#define IO_RING_COMPLETION_QUEUE_LENGTH 4096
+#define IO_RING_NUMBER_OF_BUFFERS 1024
+
+
+static void IORingCallback(uintptr_t);
+
+static void xclose(int);
+#endif
+
+
+bool
+IORing_Initialize(struct IORing *self, struct IOPoller *ioPoller)
+{
+    assert(self != NULL);
+    assert(ioPoller != NULL);
+    self->fd = -1;
+    self->ioPoller = ioPoller;
+#if defined USE_IO_URING
+    self->bufferRing = NULL;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = IO_RING_COMPLETION_QUEUE_LENGTH;
+    int fd = syscall(__NR_io_uring_setup, IO_RING_LENGTH, &params);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    uint32_t requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+                                | IORING_FEAT_FAST_POLL;
+
+    if ((params.features & requiredFeatures) != requiredFeatures) {
+        xclose(fd);
+        errno = ENOSYS;
+        return false;
+    }
+
+    size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t ringMemorySize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+    char *ringMemory = mmap(NULL, ringMemorySize, PROT_READ | PROT_WRITE
+                            , MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    if (ringMemory == MAP_FAILED) {
+        xclose(fd);
+        return false;
+    }
+
+    struct io_uring_sqe *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe)
+                                     , PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd
+                                     , IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED) {
+        munmap(ringMemory, ringMemorySize);
+        xclose(fd);
+        return false;
+    }
+
+    self->ringMemory = ringMemory;
+    self->ringMemorySize = ringMemorySize;
+    self->sqHead = (unsigned int *)(ringMemory + params.sq_off.head);
+    self->sqTail = (unsigned int *)(ringMemory + params.sq_off.tail);
+    self->sqFlags = (unsigned int *)(ringMemory + params.sq_off.flags);
+    self->sqArray = (unsigned int *)(ringMemory + params.sq_off.array);
+    self->sqMask = *(unsigned int *)(ringMemory + params.sq_off.ring_mask);
+    self->sqLength = params.sq_entries;
+    self->sqNextTail = *self->sqTail;
+    self->sqes = sqes;
+    self->cqHead = (unsigned int *)(ringMemory + params.cq_off.head);
+    self->cqTail = (unsigned int *)(ringMemory + params.cq_off.tail);
+    self->cqMask = *(unsigned int *)(ringMemory + params.cq_off.ring_mask);
+    self->cqes = (struct io_uring_cqe *)(ringMemory + params.cq_off.cqes);
+
+    if (!IOPoller_SetWatch(ioPoller, &self->ioWatch, fd, IOReadable, (uintptr_t)self
+                           , IORingCallback)) {
+        munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+        munmap(ringMemory, ringMemorySize);
+        xclose(fd);
+        return false;
+    }
+
+    self->fd = fd;
+    return true;
+#else
+    return true;
+#endif
+}
+
+
+void
+IORing_Finalize(const struct IORing *self)
+{
+    assert(self != NULL);
+#if defined USE_IO_URING
+    if (self->fd < 0) {
+        return;
+    }
+
+    IOPoller_ClearWatch(self->ioPoller, &self->ioWatch);
+
+    if (self->bufferRing != NULL) {
+        munmap(self->bufferRing, IO_RING_NUMBER_OF_BUFFERS * sizeof(struct io_uring_buf));
+        free(self->buffers);
+    }
+
+    munmap(self->sqes, self->sqLength * sizeof(struct io_uring_sqe));
+    munmap(self->ringMemory, self->ringMemorySize);
+    xclose(self->fd);
+#else
+    (void)self;
+#endif
+}
+
+
+#if defined USE_IO_URING
+bool
+IORing_Reserve(struct IORing *self, unsigned int numberOfOperations)
+{
+    assert(self != NULL && self->fd >= 0);
+
+    if (self->sqNextTail - __atomic_load_n(self->sqHead, __ATOMIC_ACQUIRE) + numberOfOperations
+        <= self->sqLength) {
+        return true;
+    }
+
+    IORing_Flush(self);
+    return self->sqNextTail - __atomic_load_n(self->sqHead, __ATOMIC_ACQUIRE)
+           + numberOfOperations <= self->sqLength;
+}
+
+
+struct io_uring_sqe *
+IORing_AddOperation(struct IORing *self, int opcode, int fd, struct IOCompletion *completion
+                    , uintptr_t data, void (*callback)(uintptr_t))
+{
+    assert(self != NULL && self->fd >= 0);
+    assert(self->sqNextTail - *self->sqHead < self->sqLength);
+    unsigned int index = self->sqNextTail++ & self->sqMask;
+    struct io_uring_sqe *sqe = &self->sqes[index];
+    memset(sqe, 0, sizeof *sqe);
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+
+    if (completion != NULL) {
+        assert(callback != NULL);
+        completion->data = data;
+        completion->callback = callback;
+        sqe->user_data = (uintptr_t)completion;
+    }
+
+    self->sqArray[index] = index;
+    return sqe;
+}
+#endif
+
+
+void
+IORing_Flush(struct IORing *self)
+{
+    assert(self != NULL);
+#if defined USE_IO_URING
+    if (self->fd < 0) {
+        return;
+    }
+
+    __atomic_store_n(self->sqTail, self->sqNextTail, __ATOMIC_RELEASE);
+    unsigned int numberOfOperations = self->sqNextTail - __atomic_load_n(self->sqHead
+                                                                         , __ATOMIC_ACQUIRE);
+
+    if (numberOfOperations == 0) {
+        return;
+    }
+
+    if (syscall(__NR_io_uring_enter, self->fd, numberOfOperations, 0, 0, NULL, 0) < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_FATAL_ERROR("`io_uring_enter()` failed: %s", strerror(errno));
+        }
+    }
+#else
+    (void)self;
+#endif
+}
+
+
+#if defined USE_IO_URING
+void
+IORing_Drain(struct IORing *self)
+{
+    assert(self != NULL);
+
+    if (self->fd < 0) {
+        return;
+    }
+
+    unsigned int cqHead = *self->cqHead;
+    unsigned int cqTail = __atomic_load_n(self->cqTail, __ATOMIC_ACQUIRE);
+
+    while (cqHead != cqTail) {
+        do {
+            struct io_uring_cqe *cqe = &self->cqes[cqHead++ & self->cqMask];
+            struct IOCompletion *completion = (struct IOCompletion *)(uintptr_t)cqe->user_data;
+            int result = cqe->res;
+            unsigned int flags = cqe->flags;
+            __atomic_store_n(self->cqHead, cqHead, __ATOMIC_RELEASE);
+
+            if (completion != NULL) {
+                completion->result = result;
+                completion->flags = flags;
+                completion->callback(completion->data);
+            }
+        } while (cqHead != cqTail);
+
+        if ((__atomic_load_n(self->sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0) {
+            syscall(__NR_io_uring_enter, self->fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+        }
+
+        cqTail = __atomic_load_n(self->cqTail, __ATOMIC_ACQUIRE);
+    }
+}
+
+
+void
+IORing_Cancel(struct IORing *self, const struct IOCompletion *completion)
+{
+    assert(self != NULL && self->fd >= 0);
+
+    if (!IORing_Reserve(self, 1)) {
+        IORing_Drain(self);
+
+        if (!IORing_Reserve(self, 1)) {
+            LOG_FATAL_ERROR("`IORing_Reserve()` failed: %s", strerror(errno));
+        }
+    }
+
+    struct io_uring_sqe *sqe = IORing_AddOperation(self, IORING_OP_ASYNC_CANCEL, -1, NULL, 0
+                                                   , NULL);
+    sqe->addr = (uintptr_t)completion;
+    IORing_Flush(self);
+    IORing_Drain(self);
+}
+
+
+bool
+IORing_SetUpBuffers(struct IORing *self)
+{
+    assert(self != NULL && self->fd >= 0);
+
+    if (self->bufferRing != NULL) {
+        return true;
+    }
+
+    size_t bufferRingSize = IO_RING_NUMBER_OF_BUFFERS * sizeof(struct io_uring_buf);
+    struct io_uring_buf_ring *bufferRing = mmap(NULL, bufferRingSize, PROT_READ | PROT_WRITE
+                                                , MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (bufferRing == MAP_FAILED) {
+        return false;
+    }
+
+    char *buffers = malloc(IO_RING_NUMBER_OF_BUFFERS * __IO_RING_BUFFER_SIZE);
+
+    if (buffers == NULL) {
+        munmap(bufferRing, bufferRingSize);
+        return false;
+    }
+
+    struct io_uring_buf_reg bufferRegistration;
+    memset(&bufferRegistration, 0, sizeof bufferRegistration);
+    bufferRegistration.ring_addr = (uintptr_t)bufferRing;
+    bufferRegistration.ring_entries = IO_RING_NUMBER_OF_BUFFERS;
+    bufferRegistration.bgid = __IO_RING_BUFFER_GROUP_ID;
+
+    if (syscall(__NR_io_uring_register, self->fd, IORING_REGISTER_PBUF_RING, &bufferRegistration
+                , 1) < 0) {
+        free(buffers);
+        munmap(bufferRing, bufferRingSize);
+        return false;
+    }
+
+    self->bufferRing = bufferRing;
+    self->buffers = buffers;
+    self->bufferRingMask = IO_RING_NUMBER_OF_BUFFERS - 1;
+    unsigned int i;
+
+    for (i = 0; i < IO_RING_NUMBER_OF_BUFFERS; ++i) {
+        IORing_ReleaseBuffer(self, buffers + i * __IO_RING_BUFFER_SIZE);
+    }
+
+    return true;
+}
+
+
+void *
+IORing_GetBuffer(const struct IORing *self, unsigned int bufferID)
+{
+    assert(self != NULL && self->bufferRing != NULL);
+    assert(bufferID < IO_RING_NUMBER_OF_BUFFERS);
+    return self->buffers + bufferID * __IO_RING_BUFFER_SIZE;
+}
+
+
+bool
+IORing_OwnsBuffer(const struct IORing *self, const void *buffer)
+{
+    assert(self != NULL);
+
+    if (self->bufferRing == NULL) {
+        return false;
+    }
+
+    uintptr_t offset = (uintptr_t)buffer - (uintptr_t)self->buffers;
+    return offset < IO_RING_NUMBER_OF_BUFFERS * __IO_RING_BUFFER_SIZE;
+}
+
+
+void
+IORing_ReleaseBuffer(struct IORing *self, const void *buffer)
+{
+    assert(self != NULL && IORing_OwnsBuffer(self, buffer));
+    unsigned int bufferID = ((const char *)buffer - self->buffers) / __IO_RING_BUFFER_SIZE;
+    unsigned short tail = self->bufferRing->tail;
+    struct io_uring_buf *bufferRingItem = &self->bufferRing->bufs[tail & self->bufferRingMask];
+    bufferRingItem->addr = (uintptr_t)(self->buffers + bufferID * __IO_RING_BUFFER_SIZE);
+    bufferRingItem->len = __IO_RING_BUFFER_SIZE;
+    bufferRingItem->bid = bufferID;
+    __atomic_store_n(&self->bufferRing->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+
+static void
+IORingCallback(uintptr_t argument)
+{
+    IORing_Drain((struct IORing *)argument);
+}
+
+
+static void
+xclose(int fd)
+{
+    int res;
+
+    do {
+        res = close(fd);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+        LOG_ERROR("`close()` failed: %s", strerror(errno));
+    }
+}
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#if defined USE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "IOPoller.h"
+
+
+#define __IO_RING_BUFFER_SIZE 4096
+#define __IO_RING_BUFFER_GROUP_ID 0
+
+struct IORing
+{
+    int fd;
+    struct IOPoller *ioPoller;
+#if defined USE_IO_URING
+    struct IOWatch ioWatch;
+    void *ringMemory;
+    size_t ringMemorySize;
+    unsigned int *sqHead;
+    unsigned int *sqTail;
+    unsigned int *sqFlags;
+    unsigned int *sqArray;
+    unsigned int sqMask;
+    unsigned int sqLength;
+    unsigned int sqNextTail;
+    struct io_uring_sqe *sqes;
+    unsigned int *cqHead;
+    unsigned int *cqTail;
+    unsigned int cqMask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *bufferRing;
+    char *buffers;
+    unsigned int bufferRingMask;
+#endif
+};
+
+
+struct IOCompletion
+{
+    int result;
+    unsigned int flags;
+    uintptr_t data;
+    void (*callback)(uintptr_t);
+};
+
+
+static inline bool IORing_IsAvailable(const struct IORing *);
+#if defined USE_IO_URING
+static inline bool IORing_HasBuffers(const struct IORing *);
+#endif
+static inline size_t IORing_GetBufferSize(const struct IORing *);
+static inline int IORing_GetBufferGroupID(const struct IORing *);
+
+bool IORing_Initialize(struct IORing *, struct IOPoller *);
+void IORing_Finalize(const struct IORing *);
+void IORing_Flush(struct IORing *);
+#if defined USE_IO_URING
+bool IORing_Reserve(struct IORing *, unsigned int);
+struct io_uring_sqe *IORing_AddOperation(struct IORing *, int, int, struct IOCompletion *
+                                         , uintptr_t, void (*)(uintptr_t));
+void IORing_Drain(struct IORing *);
+void IORing_Cancel(struct IORing *, const struct IOCompletion *);
+bool IORing_SetUpBuffers(struct IORing *);
+void *IORing_GetBuffer(const struct IORing *, unsigned int);
+bool IORing_OwnsBuffer(const struct IORing *, const void *);
+void IORing_ReleaseBuffer(struct IORing *, const void *);
+#endif
+
+
+static inline bool
+IORing_IsAvailable(const struct IORing *self)
+{
+    assert(self != NULL);
+    return self->fd >= 0;
+}
+
+
+#if defined USE_IO_URING
+static inline bool
+IORing_HasBuffers(const struct IORing *self)
+{
+    assert(self != NULL);
+    return self->bufferRing != NULL;
+}
+#endif
+
+
+static inline size_t
+IORing_GetBufferSize(const struct IORing *self)
+{
+    assert(self != NULL);
+    (void)self;
+    return __IO_RING_BUFFER_SIZE;
+}
+
+
+static inline int
+IORing_GetBufferGroupID(const struct IORing *self)
+{
+    assert(self != NULL);
+    (void)self;
+    return __IO_RING_BUFFER_GROUP_ID;
+}
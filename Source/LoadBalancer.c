@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "LoadBalancer.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "IO.h"
+#include "Runtime.h"
+#include "Scheduler.h"
+#include "Shutdown.h"
+#include "Timer.h"
+#include "Utility.h"
+
+
+enum LoadBalancerTag
+{
+    LoadBalancerHandoffTag = ConnectionHandoffTag,
+    LoadBalancerReportTag
+};
+
+
+struct LoadBalancerReport
+{
+    int32_t numberOfReadyFibers;
+    int32_t cpuUsage;
+};
+
+
+struct LoadBalancerHandoff
+{
+    void (*handler)(int, void *, size_t);
+    int connectionFD;
+    size_t dataSize;
+    char data[];
+};
+
+
+static void LoadBalancer_Run(struct LoadBalancer *);
+static bool LoadBalancer_Report(struct LoadBalancer *, uint64_t);
+static bool LoadBalancer_Receive(struct LoadBalancer *, int);
+static void LoadBalancer_AddHandoff(struct LoadBalancer *, int, size_t);
+
+static void LoadBalancerStart(uintptr_t);
+static void HandoffStart(uintptr_t);
+
+
+struct Scheduler Scheduler;
+struct Shutdown Shutdown;
+
+
+bool
+LoadBalancer_Initialize(struct LoadBalancer *self, int fd, void (*handler)(int, void *, size_t)
+                        , const struct LoadBalancerOptions *options)
+{
+    if (self == NULL || fd < 0 || handler == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    struct LoadMetrics loadMetrics;
+
+    if (!GetLoadMetrics(&loadMetrics)) {
+        return false;
+    }
+
+    self->fd = fd;
+    self->handler = handler;
+    self->reportInterval = options == NULL || options->reportInterval < 1
+                           ? 100 : options->reportInterval;
+    self->runQueueThreshold = options == NULL || options->runQueueThreshold < 1
+                              ? 4 : options->runQueueThreshold;
+    self->cpuUsageThreshold = options == NULL || options->cpuUsageThreshold < 1
+                              ? 250 : options->cpuUsageThreshold;
+    self->maxHandoffSize = options == NULL || options->maxHandoffSize == 0
+                           ? 4096 : options->maxHandoffSize;
+    self->buffer = malloc(self->maxHandoffSize);
+
+    if (self->buffer == NULL) {
+        return false;
+    }
+
+    self->isStopped = false;
+    self->isRunning = true;
+    self->errorNumber = 0;
+    self->reportTime = Timer_GetTime();
+    self->cpuTime = loadMetrics.cpuTime;
+    self->cpuUsage = 0;
+    self->hasPeerLoad = false;
+    self->finalizer = NULL;
+
+    if (!Scheduler_AddFiber(&Scheduler, LoadBalancerStart, (uintptr_t)self)) {
+        free(self->buffer);
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+LoadBalancer_Finalize(struct LoadBalancer *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    self->isStopped = true;
+
+    if (self->isRunning) {
+        self->finalizer = Scheduler_GetCurrentFiber(&Scheduler);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+        self->finalizer = NULL;
+    }
+
+    free(self->buffer);
+}
+
+
+bool
+LoadBalancer_ShouldMigrate(struct LoadBalancer *self)
+{
+    if (self == NULL || !self->isRunning || !self->hasPeerLoad
+        || Timer_GetTime() - self->peerReportTime > 3 * (uint64_t)self->reportInterval) {
+        return false;
+    }
+
+    if (self->cpuUsage - self->peerCPUUsage >= self->cpuUsageThreshold) {
+        return true;
+    }
+
+    return Scheduler_GetReadyFiberCount(&Scheduler) - self->peerNumberOfReadyFibers
+           >= self->runQueueThreshold;
+}
+
+
+ssize_t
+LoadBalancer_Migrate(struct LoadBalancer *self, int connectionFD, const void *data
+                     , size_t dataSize, int timeout)
+{
+    if (self == NULL || connectionFD < 0 || (data == NULL && dataSize >= 1)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!self->isRunning) {
+        errno = self->errorNumber == 0 ? ECANCELED : self->errorNumber;
+        return -1;
+    }
+
+    ssize_t numberOfBytes = SendConnection(self->fd, connectionFD, data, dataSize, timeout);
+
+    if (numberOfBytes >= 0) {
+        self->hasPeerLoad = false;
+    }
+
+    return numberOfBytes;
+}
+
+
+static void
+LoadBalancer_Run(struct LoadBalancer *self)
+{
+    while (!self->isStopped && Shutdown_GetState(&Shutdown) == ShutdownNone) {
+        uint64_t now = Timer_GetTime();
+
+        if (now - self->reportTime >= (uint64_t)self->reportInterval) {
+            if (!LoadBalancer_Report(self, now)) {
+                break;
+            }
+        }
+
+        if (!LoadBalancer_Receive(self, self->reportTime + self->reportInterval - now)) {
+            break;
+        }
+    }
+
+    self->isRunning = false;
+
+    if (self->finalizer != NULL) {
+        Scheduler_ResumeFiber(&Scheduler, self->finalizer);
+    }
+}
+
+
+static bool
+LoadBalancer_Report(struct LoadBalancer *self, uint64_t now)
+{
+    struct LoadMetrics loadMetrics;
+
+    if (!GetLoadMetrics(&loadMetrics)) {
+        self->errorNumber = errno;
+        return false;
+    }
+
+    self->cpuUsage = (loadMetrics.cpuTime - self->cpuTime) * 1000 / (now - self->reportTime);
+    self->reportTime = now;
+    self->cpuTime = loadMetrics.cpuTime;
+    char tag = LoadBalancerReportTag;
+
+    struct LoadBalancerReport report = {
+        .numberOfReadyFibers = loadMetrics.numberOfReadyFibers,
+        .cpuUsage = self->cpuUsage
+    };
+
+    struct iovec vector[2] = {
+        {.iov_base = &tag, .iov_len = sizeof tag},
+        {.iov_base = &report, .iov_len = sizeof report}
+    };
+
+    struct msghdr message = {.msg_iov = vector, .msg_iovlen = LENGTH_OF(vector)};
+
+    if (SendMsg(self->fd, &message, MSG_NOSIGNAL, 0) < 0 && errno != EINTR) {
+        self->errorNumber = errno;
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool
+LoadBalancer_Receive(struct LoadBalancer *self, int timeout)
+{
+    char tag;
+    struct iovec vector[2] = {
+        {.iov_base = &tag, .iov_len = sizeof tag},
+        {.iov_base = self->buffer, .iov_len = self->maxHandoffSize}
+    };
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr message = {
+        .msg_iov = vector,
+        .msg_iovlen = LENGTH_OF(vector),
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof control.buffer
+    };
+
+    ssize_t numberOfBytes = RecvMsg(self->fd, &message, MSG_CMSG_CLOEXEC, timeout);
+
+    if (numberOfBytes < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+
+        self->errorNumber = errno;
+        return false;
+    }
+
+    if (numberOfBytes == 0) {
+        self->errorNumber = ECONNRESET;
+        return false;
+    }
+
+    int connectionFD = -1;
+    struct cmsghdr *controlMessage = CMSG_FIRSTHDR(&message);
+
+    if (controlMessage != NULL && controlMessage->cmsg_level == SOL_SOCKET
+        && controlMessage->cmsg_type == SCM_RIGHTS
+        && controlMessage->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(&connectionFD, CMSG_DATA(controlMessage), sizeof(int));
+    }
+
+    size_t dataSize = numberOfBytes - sizeof tag;
+
+    if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) == 0) {
+        if (tag == LoadBalancerHandoffTag && connectionFD >= 0) {
+            LoadBalancer_AddHandoff(self, connectionFD, dataSize);
+            return true;
+        }
+
+        if (tag == LoadBalancerReportTag && dataSize == sizeof(struct LoadBalancerReport)) {
+            struct LoadBalancerReport report;
+            memcpy(&report, self->buffer, sizeof report);
+            self->hasPeerLoad = true;
+            self->peerReportTime = Timer_GetTime();
+            self->peerNumberOfReadyFibers = report.numberOfReadyFibers;
+            self->peerCPUUsage = report.cpuUsage;
+        }
+    }
+
+    if (connectionFD >= 0) {
+        Close(connectionFD);
+    }
+
+    return true;
+}
+
+
+static void
+LoadBalancer_AddHandoff(struct LoadBalancer *self, int connectionFD, size_t dataSize)
+{
+    struct LoadBalancerHandoff *handoff = malloc(sizeof *handoff + dataSize);
+
+    if (handoff == NULL) {
+        Close(connectionFD);
+        return;
+    }
+
+    handoff->handler = self->handler;
+    handoff->connectionFD = connectionFD;
+    handoff->dataSize = dataSize;
+    memcpy(handoff->data, self->buffer, dataSize);
+
+    if (!Scheduler_AddFiber(&Scheduler, HandoffStart, (uintptr_t)handoff)) {
+        Close(connectionFD);
+        free(handoff);
+    }
+}
+
+
+static void
+LoadBalancerStart(uintptr_t argument)
+{
+    LoadBalancer_Run((struct LoadBalancer *)argument);
+}
+
+
+static void
+HandoffStart(uintptr_t argument)
+{
+    struct LoadBalancerHandoff *handoff = (struct LoadBalancerHandoff *)argument;
+    handoff->handler(handoff->connectionFD, handoff->data, handoff->dataSize);
+    free(handoff);
+}
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "Multishot.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "IO.h"
+#include "Scheduler.h"
+#include "IORing.h"
+#include "Timer.h"
+#include "Shutdown.h"
+#include "Vector.h"
+#include "Utility.h"
+
+
+enum MultishotType
+{
+    MultishotAccept,
+    MultishotReceive
+};
+
+
+struct Multishot
+{
+    struct IOCompletion completion;
+    enum MultishotType type;
+    int fd;
+    int flags;
+    enum ShutdownState shutdownState;
+    bool isMultishot;
+    bool isArmed;
+    struct Vector resultVector;
+    int numberOfResults;
+    int resultIndex;
+    struct Fiber *fiber;
+    struct Timeout timeout;
+    struct ShutdownWatch shutdownWatch;
+    bool hasTimeout;
+    bool hasShutdownWatch;
+    int errorNumber;
+};
+
+
+struct MultishotResult
+{
+    int result;
+    unsigned int flags;
+};
+
+
+static void Multishot_Initialize(struct Multishot *, enum MultishotType, int, int
+                                 , enum ShutdownState);
+static void Multishot_Finalize(struct Multishot *);
+#if defined USE_IO_URING
+static bool Multishot_GetResult(struct Multishot *, struct MultishotResult *, int);
+static bool Multishot_Arm(struct Multishot *);
+static bool Multishot_Wait(struct Multishot *, int, bool);
+static void Multishot_Wake(struct Multishot *, int);
+static void Multishot_DiscardResult(struct Multishot *, const struct MultishotResult *);
+
+static void MultishotCallback1(uintptr_t);
+static void MultishotCallback2(uintptr_t);
+static void MultishotCallback3(uintptr_t);
+#endif
+
+
+struct Scheduler Scheduler;
+struct IORing IORing;
+struct Timer Timer;
+struct Shutdown Shutdown;
+
+
+bool
+Acceptor_Initialize(struct Acceptor *self, int fd, int flags)
+{
+    STATIC_ASSERT(sizeof(struct Multishot) <= sizeof(struct Acceptor));
+
+    if (self == NULL || fd < 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    Multishot_Initialize((struct Multishot *)self, MultishotAccept, fd, flags, ShutdownDraining);
+    return true;
+}
+
+
+void
+Acceptor_Finalize(struct Acceptor *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    Multishot_Finalize((struct Multishot *)self);
+}
+
+
+int
+Acceptor_Accept(struct Acceptor *self, int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct Multishot *multishot = (struct Multishot *)self;
+#if defined USE_IO_URING
+    struct MultishotResult result;
+
+    if (Multishot_GetResult(multishot, &result, timeout)) {
+        if (result.result < 0) {
+            errno = -result.result;
+            return -1;
+        }
+
+        return result.result;
+    }
+
+    if (errno != ENOTSUP) {
+        return -1;
+    }
+#endif
+
+    return Accept4(multishot->fd, NULL, NULL, multishot->flags, timeout);
+}
+
+
+bool
+Receiver_Initialize(struct Receiver *self, int fd)
+{
+    STATIC_ASSERT(sizeof(struct Multishot) <= sizeof(struct Receiver));
+
+    if (self == NULL || fd < 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    Multishot_Initialize((struct Multishot *)self, MultishotReceive, fd, 0, ShutdownExpired);
+    return true;
+}
+
+
+void
+Receiver_Finalize(struct Receiver *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    Multishot_Finalize((struct Multishot *)self);
+}
+
+
+ssize_t
+Receiver_Receive(struct Receiver *self, const void **buffer, int timeout)
+{
+    if (self == NULL || buffer == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct Multishot *multishot = (struct Multishot *)self;
+#if defined USE_IO_URING
+    struct MultishotResult result;
+
+    if (Multishot_GetResult(multishot, &result, timeout)) {
+        if (result.result > 0) {
+            *buffer = IORing_GetBuffer(&IORing, result.flags >> IORING_CQE_BUFFER_SHIFT);
+            return result.result;
+        }
+
+        Multishot_DiscardResult(multishot, &result);
+
+        if (result.result == 0) {
+            return 0;
+        }
+
+        if (result.result != -ENOBUFS) {
+            errno = -result.result;
+            return -1;
+        }
+    } else if (errno != ENOTSUP) {
+        return -1;
+    }
+#endif
+
+    void *fallbackBuffer = malloc(IORing_GetBufferSize(&IORing));
+
+    if (fallbackBuffer == NULL) {
+        return -1;
+    }
+
+    ssize_t numberOfBytes = Recv(multishot->fd, fallbackBuffer, IORing_GetBufferSize(&IORing), 0
+                                 , timeout);
+
+    if (numberOfBytes <= 0) {
+        free(fallbackBuffer);
+        return numberOfBytes;
+    }
+
+    *buffer = fallbackBuffer;
+    return numberOfBytes;
+}
+
+
+void
+Receiver_ReleaseBuffer(struct Receiver *self, const void *buffer)
+{
+    (void)self;
+
+    if (buffer == NULL) {
+        return;
+    }
+
+#if defined USE_IO_URING
+    if (IORing_OwnsBuffer(&IORing, buffer)) {
+        IORing_ReleaseBuffer(&IORing, buffer);
+        return;
+    }
+#endif
+    free((void *)buffer);
+}
+
+
+static void
+Multishot_Initialize(struct Multishot *self, enum MultishotType type, int fd, int flags
+                     , enum ShutdownState shutdownState)
+{
+    self->type = type;
+    self->fd = fd;
+    self->flags = flags;
+    self->shutdownState = shutdownState;
+#if defined USE_IO_URING
+    self->isMultishot = IORing_IsAvailable(&IORing)
+                        && (type != MultishotReceive || IORing_SetUpBuffers(&IORing));
+#else
+    self->isMultishot = false;
+#endif
+    self->isArmed = false;
+    Vector_Initialize(&self->resultVector, sizeof(struct MultishotResult));
+    self->numberOfResults = 0;
+    self->resultIndex = 0;
+    self->fiber = NULL;
+}
+
+
+static void
+Multishot_Finalize(struct Multishot *self)
+{
+#if defined USE_IO_URING
+    if (self->isArmed) {
+        IORing_Cancel(&IORing, &self->completion);
+    }
+
+    while (self->isArmed) {
+        Multishot_Wait(self, -1, false);
+    }
+
+    struct MultishotResult *results = Vector_GetElements(&self->resultVector);
+    int i;
+
+    for (i = self->resultIndex; i < self->numberOfResults; ++i) {
+        Multishot_DiscardResult(self, &results[i]);
+    }
+#endif
+
+    Vector_Finalize(&self->resultVector);
+}
+
+
+#if defined USE_IO_URING
+static bool
+Multishot_GetResult(struct Multishot *self, struct MultishotResult *result, int timeout)
+{
+    for (;;) {
+        if (self->resultIndex < self->numberOfResults) {
+            struct MultishotResult *results = Vector_GetElements(&self->resultVector);
+            *result = results[self->resultIndex++];
+
+            if (self->resultIndex == self->numberOfResults) {
+                self->resultIndex = 0;
+                self->numberOfResults = 0;
+            }
+
+            if (result->result == -EINVAL && (result->flags & IORING_CQE_F_MORE) == 0) {
+                self->isMultishot = false;
+                errno = ENOTSUP;
+                return false;
+            }
+
+            return true;
+        }
+
+        if (!self->isMultishot) {
+            errno = ENOTSUP;
+            return false;
+        }
+
+        if (Shutdown_GetState(&Shutdown) >= self->shutdownState) {
+            errno = ECANCELED;
+            return false;
+        }
+
+        if (!self->isArmed && !Multishot_Arm(self)) {
+            return false;
+        }
+
+        if (!Multishot_Wait(self, timeout, true)) {
+            return false;
+        }
+    }
+}
+
+
+static bool
+Multishot_Arm(struct Multishot *self)
+{
+    if (!IORing_Reserve(&IORing, 1)) {
+        errno = ENOTSUP;
+        return false;
+    }
+
+    int opcode = self->type == MultishotAccept ? IORING_OP_ACCEPT : IORING_OP_RECV;
+    struct io_uring_sqe *sqe = IORing_AddOperation(&IORing, opcode, self->fd, &self->completion
+                                                   , (uintptr_t)self, MultishotCallback1);
+
+    if (self->type == MultishotAccept) {
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = self->flags | O_NONBLOCK;
+    } else {
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = IORing_GetBufferGroupID(&IORing);
+    }
+
+    self->isArmed = true;
+    return true;
+}
+
+
+static bool
+Multishot_Wait(struct Multishot *self, int timeout, bool isCancelable)
+{
+    timeout = Timer_ApplyDeadline(&Timer, timeout
+                                  , Fiber_GetDeadline(Scheduler_GetCurrentFiber(&Scheduler)));
+
+    if (timeout >= 0) {
+        if (!Timer_SetTimeout(&Timer, &self->timeout, timeout, (uintptr_t)self
+                              , MultishotCallback2)) {
+            return false;
+        }
+    }
+
+    self->hasTimeout = timeout >= 0;
+
+    if (isCancelable) {
+        Shutdown_SetWatch(&Shutdown, &self->shutdownWatch, self->shutdownState, (uintptr_t)self
+                          , MultishotCallback3);
+    }
+
+    self->hasShutdownWatch = isCancelable;
+    self->fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    Scheduler_SuspendCurrentFiber(&Scheduler);
+
+    if (self->errorNumber != 0) {
+        errno = self->errorNumber;
+        return false;
+    }
+
+    return true;
+}
+
+
+static void
+Multishot_Wake(struct Multishot *self, int errorNumber)
+{
+    if (self->fiber == NULL) {
+        return;
+    }
+
+    if (self->hasTimeout && errorNumber != EINTR) {
+        Timer_ClearTimeout(&Timer, &self->timeout);
+    }
+
+    if (self->hasShutdownWatch && errorNumber != ECANCELED) {
+        Shutdown_ClearWatch(&Shutdown, &self->shutdownWatch);
+    }
+
+    self->errorNumber = errorNumber;
+    Scheduler_ResumeFiber(&Scheduler, self->fiber);
+    self->fiber = NULL;
+}
+
+
+static void
+Multishot_DiscardResult(struct Multishot *self, const struct MultishotResult *result)
+{
+    if (self->type == MultishotAccept) {
+        if (result->result >= 0) {
+            close(result->result);
+        }
+    } else {
+        if ((result->flags & IORING_CQE_F_BUFFER) != 0) {
+            IORing_ReleaseBuffer(&IORing, IORing_GetBuffer(&IORing, result->flags
+                                                                    >> IORING_CQE_BUFFER_SHIFT));
+        }
+    }
+}
+
+
+static void
+MultishotCallback1(uintptr_t argument)
+{
+    struct Multishot *self = (struct Multishot *)argument;
+    struct MultishotResult result = {
+        .result = self->completion.result,
+        .flags = self->completion.flags
+    };
+
+    if ((result.flags & IORING_CQE_F_MORE) == 0) {
+        self->isArmed = false;
+    }
+
+    if (self->numberOfResults == Vector_GetLength(&self->resultVector)
+        && !Vector_SetLength(&self->resultVector, self->numberOfResults + 1, false)) {
+        Multishot_DiscardResult(self, &result);
+    } else {
+        struct MultishotResult *results = Vector_GetElements(&self->resultVector);
+        results[self->numberOfResults++] = result;
+    }
+
+    Multishot_Wake(self, 0);
+}
+
+
+static void
+MultishotCallback2(uintptr_t argument)
+{
+    Multishot_Wake((struct Multishot *)argument, EINTR);
+}
+
+
+static void
+MultishotCallback3(uintptr_t argument)
+{
+    Multishot_Wake((struct Multishot *)argument, ECANCELED);
+}
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "Reactor.h"
+
+#include <stddef.h>
+#include <errno.h>
+
+#include "IOPoller.h"
+#include "Timer.h"
+#include "Utility.h"
+
+
+struct ReactorWatchBody
+{
+    struct IOWatch ioWatch;
+    uintptr_t data;
+    void (*callback)(uintptr_t);
+    bool isActive;
+};
+
+
+struct ReactorTimeoutBody
+{
+    struct Timeout timeout;
+    uintptr_t data;
+    void (*callback)(uintptr_t);
+    bool isActive;
+};
+
+
+static void ReactorWatchCallback(uintptr_t);
+static void ReactorTimeoutCallback(uintptr_t);
+
+
+struct IOPoller IOPoller;
+struct Timer Timer;
+int ReactorCount;
+
+
+void
+Reactor_InitializeWatch(struct ReactorWatch *watch)
+{
+    STATIC_ASSERT(sizeof(struct ReactorWatchBody) <= sizeof(struct ReactorWatch));
+    struct ReactorWatchBody *body = (struct ReactorWatchBody *)watch;
+    body->isActive = false;
+}
+
+
+bool
+Reactor_SetWatch(struct ReactorWatch *watch, int fd, enum ReactorCondition condition
+                 , uintptr_t data, void (*callback)(uintptr_t))
+{
+    if (fd < 0 || (condition != ReactorReadable && condition != ReactorWritable)
+        || callback == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    Reactor_ClearWatch(watch);
+    struct ReactorWatchBody *body = (struct ReactorWatchBody *)watch;
+    enum IOCondition ioCondition = condition == ReactorReadable ? IOReadable : IOWritable;
+
+    if (!IOPoller_SetWatch(&IOPoller, &body->ioWatch, fd, ioCondition, (uintptr_t)body
+                           , ReactorWatchCallback)) {
+        return false;
+    }
+
+    body->data = data;
+    body->callback = callback;
+    body->isActive = true;
+    ++ReactorCount;
+    return true;
+}
+
+
+void
+Reactor_ClearWatch(struct ReactorWatch *watch)
+{
+    struct ReactorWatchBody *body = (struct ReactorWatchBody *)watch;
+
+    if (!body->isActive) {
+        return;
+    }
+
+    IOPoller_ClearWatch(&IOPoller, &body->ioWatch);
+    body->isActive = false;
+    --ReactorCount;
+}
+
+
+void
+Reactor_InitializeTimeout(struct ReactorTimeout *timeout)
+{
+    STATIC_ASSERT(sizeof(struct ReactorTimeoutBody) <= sizeof(struct ReactorTimeout));
+    struct ReactorTimeoutBody *body = (struct ReactorTimeoutBody *)timeout;
+    body->isActive = false;
+}
+
+
+bool
+Reactor_SetTimeout(struct ReactorTimeout *timeout, int delay, uintptr_t data
+                   , void (*callback)(uintptr_t))
+{
+    if (callback == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    Reactor_ClearTimeout(timeout);
+    struct ReactorTimeoutBody *body = (struct ReactorTimeoutBody *)timeout;
+
+    if (!Timer_SetTimeout(&Timer, &body->timeout, delay, (uintptr_t)body
+                          , ReactorTimeoutCallback)) {
+        return false;
+    }
+
+    body->data = data;
+    body->callback = callback;
+    body->isActive = true;
+    ++ReactorCount;
+    return true;
+}
+
+
+void
+Reactor_ClearTimeout(struct ReactorTimeout *timeout)
+{
+    struct ReactorTimeoutBody *body = (struct ReactorTimeoutBody *)timeout;
+
+    if (!body->isActive) {
+        return;
+    }
+
+    if (Timer_HasTimeout(&Timer, &body->timeout)) {
+        Timer_ClearTimeout(&Timer, &body->timeout);
+    }
+
+    body->isActive = false;
+    --ReactorCount;
+}
+
+
+static void
+ReactorWatchCallback(uintptr_t argument)
+{
+    struct ReactorWatchBody *body = (struct ReactorWatchBody *)argument;
+
+    if (!body->isActive) {
+        return;
+    }
+
+    body->callback(body->data);
+}
+
+
+static void
+ReactorTimeoutCallback(uintptr_t argument)
+{
+    struct ReactorTimeoutBody *body = (struct ReactorTimeoutBody *)argument;
+
+    if (!body->isActive || Timer_HasTimeout(&Timer, &body->timeout)) {
+        return;
+    }
+
+    body->isActive = false;
+    --ReactorCount;
+    body->callback(body->data);
+}
@@ -8,24 +8,57 @@
 #include <errno.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "Scheduler.h"
 #include "IOPoller.h"
+#include "IORing.h"
 #include "Timer.h"
 #include "ThreadPool.h"
 #include "Async.h"
+#include "MemoryPool.h"
+#include "WaitTable.h"
+#include "Shutdown.h"
 #include "Logging.h"
 
 
+struct Migration
+{
+    struct Work work;
+    struct Fiber *fiber;
+};
+
+
 static void FiberMainWrapper(uintptr_t);
 static void Loop(void);
-static void SleepCallback(uintptr_t);
+static void SleepCallback1(uintptr_t);
+static void SleepCallback2(uintptr_t);
+static void RequestShutdownCallback(uintptr_t);
+static void WaitOnAddressCallback1(uintptr_t);
+static void WaitOnAddressCallback2(uintptr_t);
+static void WaitOnAddressCallback3(uintptr_t);
+static void WaitOnAddressCallback4(uintptr_t);
+static void WaitOnAddressCallback5(uintptr_t);
+static void SwitchToWorkerThreadCallback1(uintptr_t);
+static void SwitchToWorkerThreadCallback2(uintptr_t);
+static void SwitchToWorkerThreadCallback3(uintptr_t);
 
 
 struct Scheduler Scheduler;
 struct IOPoller IOPoller;
+struct IORing IORing;
 struct Timer Timer;
 struct ThreadPool ThreadPool;
+struct WaitTable WaitTable;
+struct Shutdown Shutdown;
+int ReactorCount;
+
+static struct MemoryPool MigrationMemoryPool;
+static __thread struct Fiber *MigratedFiber;
+static struct Timeout ShutdownTimeout;
+static uint64_t ShutdownDeadline;
+static bool ShutdownDeadlineHasPassed;
 
 
 int
@@ -33,7 +66,15 @@ main(int argc, char **argv)
 {
     Scheduler_Initialize(&Scheduler);
     IOPoller_Initialize(&IOPoller);
+
+    if (!IORing_Initialize(&IORing, &IOPoller)) {
+        LOG_WARNING("io_uring unavailable, falling back to epoll: %s", strerror(errno));
+    }
+
     Timer_Initialize(&Timer);
+    WaitTable_Initialize(&WaitTable);
+    Shutdown_Initialize(&Shutdown);
+    MemoryPool_Initialize(&MigrationMemoryPool, sizeof(struct Migration));
 
     if (!ThreadPool_Initialize(&ThreadPool, &IOPoller)) {
         LOG_FATAL_ERROR("`ThreadPool_Initialize()` failed: %s", strerror(errno));
@@ -49,13 +90,16 @@ main(int argc, char **argv)
 
     context.argc = argc;
     context.argv = argv;
+    context.status = EXIT_FAILURE;
     Scheduler_AddFiber(&Scheduler, FiberMainWrapper, (uintptr_t)&context);
     Loop();
     ThreadPool_Stop(&ThreadPool);
     ThreadPool_Finalize(&ThreadPool);
     Scheduler_Finalize(&Scheduler);
+    IORing_Finalize(&IORing);
     IOPoller_Finalize(&IOPoller);
     Timer_Finalize(&Timer);
+    MemoryPool_Finalize(&MigrationMemoryPool);
     return context.status;
 }
 
@@ -89,6 +133,24 @@ YieldCurrentFiber(void)
 }
 
 
+struct Fiber *
+GetCurrentFiber(void)
+{
+    return Scheduler_GetCurrentFiber(&Scheduler);
+}
+
+
+bool
+YieldToFiber(struct Fiber *fiber)
+{
+    if (fiber == NULL || fiber == Scheduler_GetCurrentFiber(&Scheduler)) {
+        return false;
+    }
+
+    return Scheduler_YieldCurrentFiberTo(&Scheduler, fiber);
+}
+
+
 NORETURN void
 ExitCurrentFiber(void)
 {
@@ -99,18 +161,260 @@ ExitCurrentFiber(void)
 bool
 SleepCurrentFiber(int duration)
 {
-    struct Timeout timeout;
+    if (Shutdown_GetState(&Shutdown) == ShutdownExpired) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    struct {
+        struct Timeout timeout;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } context;
+
+    context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    int delay = Timer_ApplyDeadline(&Timer, duration, Fiber_GetDeadline(context.fiber));
 
-    if (!Timer_SetTimeout(&Timer, &timeout, duration
-                          , (uintptr_t)Scheduler_GetCurrentFiber(&Scheduler), SleepCallback)) {
+    if (!Timer_SetTimeout(&Timer, &context.timeout, delay, (uintptr_t)&context, SleepCallback1)) {
         return false;
     }
 
+    Shutdown_SetWatch(&Shutdown, &context.shutdownWatch, ShutdownExpired, (uintptr_t)&context
+                      , SleepCallback2);
     Scheduler_SuspendCurrentFiber(&Scheduler);
+
+    if (!context.ok) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    if (delay != duration) {
+        errno = EINTR;
+        return false;
+    }
+
     return true;
 }
 
 
+void
+SetSchedulingPolicy(enum SchedulingPolicy schedulingPolicy)
+{
+    Scheduler_SetEarliestDeadlineFirst(&Scheduler
+                                       , schedulingPolicy == SchedulingEarliestDeadlineFirst);
+}
+
+
+int
+GetNumberOfMissedDeadlines(void)
+{
+    return Scheduler_GetNumberOfMissedDeadlines(&Scheduler);
+}
+
+
+uint64_t
+GetCurrentTime(void)
+{
+    return Timer_GetTime();
+}
+
+
+uint64_t
+GetFiberDeadline(void)
+{
+    return Fiber_GetDeadline(Scheduler_GetCurrentFiber(&Scheduler));
+}
+
+
+uint64_t
+SetFiberDeadline(uint64_t deadline)
+{
+    struct Fiber *fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    uint64_t oldDeadline = Fiber_GetDeadline(fiber);
+
+    if (deadline < oldDeadline) {
+        Fiber_SetDeadline(fiber, deadline);
+    }
+
+    return oldDeadline;
+}
+
+
+void
+RestoreFiberDeadline(uint64_t deadline)
+{
+    Fiber_SetDeadline(Scheduler_GetCurrentFiber(&Scheduler), deadline);
+}
+
+
+bool
+WaitOnAddress(const volatile int *address, int expectedValue, int timeout)
+{
+    if (*address != expectedValue) {
+        errno = EAGAIN;
+        return false;
+    }
+
+    if (Shutdown_GetState(&Shutdown) == ShutdownExpired) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    timeout = Timer_ApplyDeadline(&Timer, timeout
+                                  , Fiber_GetDeadline(Scheduler_GetCurrentFiber(&Scheduler)));
+
+    if (timeout < 0) {
+        struct {
+            struct AddressWaiter waiter;
+            struct ShutdownWatch shutdownWatch;
+            struct Fiber *fiber;
+            bool ok;
+        } context;
+
+        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+        WaitTable_AddWaiter(&WaitTable, &context.waiter, (const void *)address
+                            , (uintptr_t)&context, WaitOnAddressCallback1);
+        Shutdown_SetWatch(&Shutdown, &context.shutdownWatch, ShutdownExpired, (uintptr_t)&context
+                          , WaitOnAddressCallback4);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+
+        if (!context.ok) {
+            errno = ECANCELED;
+            return false;
+        }
+    } else {
+        struct {
+            struct AddressWaiter waiter;
+            struct ShutdownWatch shutdownWatch;
+            struct Timeout timeout;
+            struct Fiber *fiber;
+            bool ok;
+            int errorNumber;
+        } context;
+
+        context.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+
+        if (!Timer_SetTimeout(&Timer, &context.timeout, timeout, (uintptr_t)&context
+                              , WaitOnAddressCallback3)) {
+            return false;
+        }
+
+        WaitTable_AddWaiter(&WaitTable, &context.waiter, (const void *)address
+                            , (uintptr_t)&context, WaitOnAddressCallback2);
+        Shutdown_SetWatch(&Shutdown, &context.shutdownWatch, ShutdownExpired, (uintptr_t)&context
+                          , WaitOnAddressCallback5);
+        Scheduler_SuspendCurrentFiber(&Scheduler);
+
+        if (!context.ok) {
+            errno = context.errorNumber;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int
+WakeAddress(const volatile int *address, int numberOfWaiters)
+{
+    return WaitTable_WakeWaiters(&WaitTable, (const void *)address, numberOfWaiters);
+}
+
+
+bool
+RequestShutdown(uint64_t deadline)
+{
+    if (Shutdown_GetState(&Shutdown) == ShutdownNone) {
+        ShutdownDeadline = UINT64_MAX;
+        Shutdown_SetState(&Shutdown, ShutdownDraining);
+    }
+
+    if (Shutdown_GetState(&Shutdown) == ShutdownExpired || deadline >= ShutdownDeadline) {
+        return true;
+    }
+
+    if (ShutdownDeadline != UINT64_MAX) {
+        Timer_ClearTimeout(&Timer, &ShutdownTimeout);
+        ShutdownDeadline = UINT64_MAX;
+    }
+
+    if (!Timer_SetTimeout(&Timer, &ShutdownTimeout, Timer_ApplyDeadline(&Timer, -1, deadline), 0
+                          , RequestShutdownCallback)) {
+        return false;
+    }
+
+    ShutdownDeadline = deadline;
+    return true;
+}
+
+
+bool
+IsShuttingDown(void)
+{
+    return Shutdown_GetState(&Shutdown) != ShutdownNone;
+}
+
+
+bool
+GetLoadMetrics(struct LoadMetrics *loadMetrics)
+{
+    if (loadMetrics == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) < 0) {
+        return false;
+    }
+
+    loadMetrics->numberOfFibers = Scheduler_GetFiberCount(&Scheduler);
+    loadMetrics->numberOfReadyFibers = Scheduler_GetReadyFiberCount(&Scheduler);
+    loadMetrics->cpuTime = t.tv_sec * 1000 + t.tv_nsec / 1000000;
+    return true;
+}
+
+
+void
+SetBusyPolling(int maxDuration)
+{
+    IOPoller_SetBusyPolling(&IOPoller, maxDuration >= 0 ? maxDuration : 0);
+}
+
+
+bool
+SwitchToWorkerThread(void)
+{
+    if (MigratedFiber != NULL) {
+        return true;
+    }
+
+    struct Migration *migration = MemoryPool_AllocateBlock(&MigrationMemoryPool);
+
+    if (migration == NULL) {
+        return false;
+    }
+
+    migration->fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    Scheduler_DetachCurrentFiber(&Scheduler, SwitchToWorkerThreadCallback1, (uintptr_t)migration);
+    return true;
+}
+
+
+void
+SwitchBackToLoop(void)
+{
+    if (MigratedFiber == NULL) {
+        return;
+    }
+
+    Fiber_SwapContext(MigratedFiber);
+}
+
+
 static void
 FiberMainWrapper(uintptr_t argument)
 {
@@ -133,10 +437,17 @@ Loop(void)
     for (;;) {
         Scheduler_Tick(&Scheduler);
 
-        if (Scheduler_GetFiberCount(&Scheduler) == 0) {
+        if (Scheduler_GetFiberCount(&Scheduler) == 0 && ReactorCount == 0) {
             break;
         }
 
+        if (Shutdown_GetState(&Shutdown) == ShutdownExpired) {
+            LOG_WARNING("shutdown deadline passed, giving up %d fiber(s)"
+                        , Scheduler_GetFiberCount(&Scheduler));
+            break;
+        }
+
+        IORing_Flush(&IORing);
         bool ok;
 
         do {
@@ -154,6 +465,10 @@ Loop(void)
         }
 
         Async_DispatchCalls(&async);
+
+        if (ShutdownDeadlineHasPassed) {
+            Shutdown_SetState(&Shutdown, ShutdownExpired);
+        }
     }
 
     Async_Finalize(&async);
@@ -161,7 +476,159 @@ Loop(void)
 
 
 static void
-SleepCallback(uintptr_t argument)
+SleepCallback1(uintptr_t argument)
+{
+    struct {
+        struct Timeout timeout;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } *context = (void *)argument;
+
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
+    context->ok = true;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+SleepCallback2(uintptr_t argument)
+{
+    struct {
+        struct Timeout timeout;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } *context = (void *)argument;
+
+    Timer_ClearTimeout(&Timer, &context->timeout);
+    context->ok = false;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+RequestShutdownCallback(uintptr_t argument)
+{
+    (void)argument;
+    ShutdownDeadlineHasPassed = true;
+}
+
+
+static void
+WaitOnAddressCallback1(uintptr_t argument)
+{
+    struct {
+        struct AddressWaiter waiter;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } *context = (void *)argument;
+
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
+    context->ok = true;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+WaitOnAddressCallback2(uintptr_t argument)
+{
+    struct {
+        struct AddressWaiter waiter;
+        struct ShutdownWatch shutdownWatch;
+        struct Timeout timeout;
+        struct Fiber *fiber;
+        bool ok;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
+    Timer_ClearTimeout(&Timer, &context->timeout);
+    context->ok = true;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+WaitOnAddressCallback3(uintptr_t argument)
+{
+    struct {
+        struct AddressWaiter waiter;
+        struct ShutdownWatch shutdownWatch;
+        struct Timeout timeout;
+        struct Fiber *fiber;
+        bool ok;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    WaitTable_RemoveWaiter(&WaitTable, &context->waiter);
+    Shutdown_ClearWatch(&Shutdown, &context->shutdownWatch);
+    context->ok = false;
+    context->errorNumber = EINTR;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+WaitOnAddressCallback4(uintptr_t argument)
+{
+    struct {
+        struct AddressWaiter waiter;
+        struct ShutdownWatch shutdownWatch;
+        struct Fiber *fiber;
+        bool ok;
+    } *context = (void *)argument;
+
+    WaitTable_RemoveWaiter(&WaitTable, &context->waiter);
+    context->ok = false;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+WaitOnAddressCallback5(uintptr_t argument)
+{
+    struct {
+        struct AddressWaiter waiter;
+        struct ShutdownWatch shutdownWatch;
+        struct Timeout timeout;
+        struct Fiber *fiber;
+        bool ok;
+        int errorNumber;
+    } *context = (void *)argument;
+
+    WaitTable_RemoveWaiter(&WaitTable, &context->waiter);
+    Timer_ClearTimeout(&Timer, &context->timeout);
+    context->ok = false;
+    context->errorNumber = ECANCELED;
+    Scheduler_ResumeFiber(&Scheduler, context->fiber);
+}
+
+
+static void
+SwitchToWorkerThreadCallback1(uintptr_t argument)
+{
+    struct Migration *migration = (struct Migration *)argument;
+    ThreadPool_PostWork(&ThreadPool, &migration->work, SwitchToWorkerThreadCallback2, argument
+                        , argument, SwitchToWorkerThreadCallback3);
+}
+
+
+static void
+SwitchToWorkerThreadCallback2(uintptr_t argument)
+{
+    struct Migration *migration = (struct Migration *)argument;
+    MigratedFiber = migration->fiber;
+    Fiber_SwapContext(migration->fiber);
+    MigratedFiber = NULL;
+}
+
+
+static void
+SwitchToWorkerThreadCallback3(uintptr_t argument)
 {
-    Scheduler_ResumeFiber(&Scheduler, (struct Fiber *)argument);
+    struct Migration *migration = (struct Migration *)argument;
+    Scheduler_ResumeFiber(&Scheduler, migration->fiber);
+    MemoryPool_FreeBlock(&MigrationMemoryPool, migration);
 }
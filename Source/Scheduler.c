@@ -12,9 +12,10 @@
 #endif
 
 #include "Utility.h"
+#include "Timer.h"
 
 
-#define FIBER_SIZE ((size_t)65536)
+#define FIBER_STACK_SIZE ((size_t)65536)
 
 
 struct Fiber
@@ -28,30 +29,48 @@ struct Fiber
     jmp_buf *context;
     void (*function)(uintptr_t);
     uintptr_t argument;
+    uint64_t deadline;
+    bool hasMissedDeadline;
+    bool isReady;
+    bool isInReadyFiberHeap;
+    struct HeapNode heapNode;
+    uint64_t sequenceNumber;
 };
 
 
 static NORETURN void Scheduler_SwitchToFiber(struct Scheduler *, struct Fiber *);
 static NORETURN void Scheduler_FiberStart(struct Scheduler *, struct Fiber *);
 static NORETURN void Scheduler_SwitchTo(struct Scheduler *);
+static bool Scheduler_HasReadyFibers(const struct Scheduler *);
+static void Scheduler_InsertReadyFiber(struct Scheduler *, struct Fiber *, bool);
+static struct Fiber *Scheduler_RemoveReadyFiber(struct Scheduler *);
 
-static struct Fiber *Fiber_Allocate(void);
-static void Fiber_Free(struct Fiber *);
+static int FiberHeapNode_Compare(const struct HeapNode *, const struct HeapNode *);
+
+static struct Fiber *Fiber_Allocate(struct MemoryPool *);
+static void Fiber_Free(struct Fiber *, struct MemoryPool *);
 
 
 void
 Scheduler_Initialize(struct Scheduler *self)
 {
     assert(self != NULL);
+    MemoryPool_Initialize(&self->fiberMemoryPool, sizeof(struct Fiber));
     self->activeFiber = NULL;
     List_Initialize(&self->readyFiberListHead);
+    Heap_Initialize(&self->readyFiberHeap);
+    self->isEarliestDeadlineFirst = false;
+    self->nextSequenceNumber = 0;
+    self->numberOfMissedDeadlines = 0;
     List_Initialize(&self->deadFiberListHead);
     self->fiberCount = 0;
+    self->readyFiberCount = 0;
+    self->detachCallback = NULL;
 }
 
 
 void
-Scheduler_Finalize(const struct Scheduler *self)
+Scheduler_Finalize(struct Scheduler *self)
 {
     assert(self != NULL && self->activeFiber == NULL);
     struct ListItem *fiberListItem = List_GetBack(&self->readyFiberListHead);
@@ -59,8 +78,46 @@ Scheduler_Finalize(const struct Scheduler *self)
     while (fiberListItem != &self->readyFiberListHead) {
         struct Fiber *fiber = CONTAINER_OF(fiberListItem, struct Fiber, listItem);
         fiberListItem = ListItem_GetPrev(fiberListItem);
-        Fiber_Free(fiber);
+        Fiber_Free(fiber, &self->fiberMemoryPool);
     }
+
+    struct HeapNode *fiberHeapNode;
+
+    while ((fiberHeapNode = Heap_GetTop(&self->readyFiberHeap)) != NULL) {
+        Heap_RemoveNode(&self->readyFiberHeap, fiberHeapNode, FiberHeapNode_Compare);
+        Fiber_Free(CONTAINER_OF(fiberHeapNode, struct Fiber, heapNode), &self->fiberMemoryPool);
+    }
+
+    Heap_Finalize(&self->readyFiberHeap);
+    MemoryPool_Finalize(&self->fiberMemoryPool);
+}
+
+
+void
+Scheduler_SetEarliestDeadlineFirst(struct Scheduler *self, bool isEarliestDeadlineFirst)
+{
+    assert(self != NULL);
+
+    if (self->isEarliestDeadlineFirst == isEarliestDeadlineFirst) {
+        return;
+    }
+
+    self->isEarliestDeadlineFirst = isEarliestDeadlineFirst;
+
+    if (isEarliestDeadlineFirst) {
+        return;
+    }
+
+    struct HeapNode *fiberHeapNode;
+
+    while ((fiberHeapNode = Heap_GetTop(&self->readyFiberHeap)) != NULL) {
+        struct Fiber *fiber = CONTAINER_OF(fiberHeapNode, struct Fiber, heapNode);
+        Heap_RemoveNode(&self->readyFiberHeap, fiberHeapNode, FiberHeapNode_Compare);
+        fiber->isInReadyFiberHeap = false;
+        List_InsertBack(&self->readyFiberListHead, &fiber->listItem);
+    }
+
+    Heap_ShrinkToFit(&self->readyFiberHeap);
 }
 
 
@@ -72,7 +129,7 @@ Scheduler_AddFiber(struct Scheduler *self, void (*function)(uintptr_t), uintptr_
     struct Fiber *fiber;
 
     if (List_IsEmpty(&self->deadFiberListHead)) {
-        fiber = Fiber_Allocate();
+        fiber = Fiber_Allocate(&self->fiberMemoryPool);
 
         if (fiber == NULL) {
             return false;
@@ -85,7 +142,9 @@ Scheduler_AddFiber(struct Scheduler *self, void (*function)(uintptr_t), uintptr_
     fiber->context = NULL;
     fiber->function = function;
     fiber->argument = argument;
-    List_InsertBack(&self->readyFiberListHead, &fiber->listItem);
+    fiber->deadline = UINT64_MAX;
+    fiber->hasMissedDeadline = false;
+    Scheduler_InsertReadyFiber(self, fiber, false);
     ++self->fiberCount;
     return true;
 }
@@ -107,10 +166,12 @@ Scheduler_AddAndRunFiber(struct Scheduler *self, void (*function)(uintptr_t), ui
     }
 
     self->activeFiber->context = &context;
-    List_InsertFront(&self->readyFiberListHead, &self->activeFiber->listItem);
     struct Fiber *fiber = CONTAINER_OF(List_GetBack(&self->readyFiberListHead), struct Fiber
                                        , listItem);
     ListItem_Remove(&fiber->listItem);
+    fiber->isReady = false;
+    --self->readyFiberCount;
+    Scheduler_InsertReadyFiber(self, self->activeFiber, true);
     Scheduler_SwitchToFiber(self, fiber);
 }
 
@@ -120,7 +181,7 @@ Scheduler_YieldCurrentFiber(struct Scheduler *self)
 {
     assert(self != NULL && self->activeFiber != NULL);
 
-    if (List_IsEmpty(&self->readyFiberListHead)) {
+    if (!Scheduler_HasReadyFibers(self)) {
         return;
     }
 
@@ -131,10 +192,30 @@ Scheduler_YieldCurrentFiber(struct Scheduler *self)
     }
 
     self->activeFiber->context = &context;
-    List_InsertBack(&self->readyFiberListHead, &self->activeFiber->listItem);
-    struct Fiber *fiber = CONTAINER_OF(List_GetFront(&self->readyFiberListHead), struct Fiber
-                                       , listItem);
-    ListItem_Remove(&fiber->listItem);
+    Scheduler_InsertReadyFiber(self, self->activeFiber, false);
+    Scheduler_SwitchToFiber(self, Scheduler_RemoveReadyFiber(self));
+}
+
+
+bool
+Scheduler_YieldCurrentFiberTo(struct Scheduler *self, struct Fiber *fiber)
+{
+    assert(self != NULL && self->activeFiber != NULL);
+    assert(fiber != NULL);
+
+    if (!fiber->isReady) {
+        return false;
+    }
+
+    jmp_buf context;
+
+    if (setjmp(context) != 0) {
+        return true;
+    }
+
+    self->activeFiber->context = &context;
+    Scheduler_UnresumeFiber(self, fiber);
+    Scheduler_InsertReadyFiber(self, self->activeFiber, false);
     Scheduler_SwitchToFiber(self, fiber);
 }
 
@@ -152,13 +233,10 @@ Scheduler_SuspendCurrentFiber(struct Scheduler *self)
 
     self->activeFiber->context = &context;
 
-    if (List_IsEmpty(&self->readyFiberListHead)) {
-        Scheduler_SwitchTo(self);
+    if (Scheduler_HasReadyFibers(self)) {
+        Scheduler_SwitchToFiber(self, Scheduler_RemoveReadyFiber(self));
     } else {
-        struct Fiber *fiber = CONTAINER_OF(List_GetFront(&self->readyFiberListHead), struct Fiber
-                                           , listItem);
-        ListItem_Remove(&fiber->listItem);
-        Scheduler_SwitchToFiber(self, fiber);
+        Scheduler_SwitchTo(self);
     }
 }
 
@@ -168,7 +246,7 @@ Scheduler_ResumeFiber(struct Scheduler *self, struct Fiber *fiber)
 {
     assert(self != NULL && self->activeFiber != fiber);
     assert(fiber != NULL);
-    List_InsertBack(&self->readyFiberListHead, &fiber->listItem);
+    Scheduler_InsertReadyFiber(self, fiber, false);
 }
 
 
@@ -177,8 +255,16 @@ Scheduler_UnresumeFiber(struct Scheduler *self, struct Fiber *fiber)
 {
     assert(self != NULL && self->activeFiber != fiber);
     assert(fiber != NULL);
-    (void)self;
-    ListItem_Remove(&fiber->listItem);
+
+    if (fiber->isInReadyFiberHeap) {
+        Heap_RemoveNode(&self->readyFiberHeap, &fiber->heapNode, FiberHeapNode_Compare);
+        fiber->isInReadyFiberHeap = false;
+    } else {
+        ListItem_Remove(&fiber->listItem);
+    }
+
+    fiber->isReady = false;
+    --self->readyFiberCount;
 }
 
 
@@ -189,23 +275,39 @@ Scheduler_ExitCurrentFiber(struct Scheduler *self)
     List_InsertBack(&self->deadFiberListHead, &self->activeFiber->listItem);
     --self->fiberCount;
 
-    if (List_IsEmpty(&self->readyFiberListHead)) {
-        Scheduler_SwitchTo(self);
+    if (Scheduler_HasReadyFibers(self)) {
+        Scheduler_SwitchToFiber(self, Scheduler_RemoveReadyFiber(self));
     } else {
-        struct Fiber *fiber = CONTAINER_OF(List_GetFront(&self->readyFiberListHead), struct Fiber
-                                           , listItem);
-        ListItem_Remove(&fiber->listItem);
-        Scheduler_SwitchToFiber(self, fiber);
+        Scheduler_SwitchTo(self);
     }
 }
 
 
+void
+Scheduler_DetachCurrentFiber(struct Scheduler *self, void (*callback)(uintptr_t), uintptr_t data)
+{
+    assert(self != NULL && self->activeFiber != NULL);
+    assert(callback != NULL);
+
+    jmp_buf context;
+
+    if (setjmp(context) != 0) {
+        return;
+    }
+
+    self->activeFiber->context = &context;
+    self->detachCallback = callback;
+    self->detachData = data;
+    Scheduler_SwitchTo(self);
+}
+
+
 void
 Scheduler_Tick(struct Scheduler *self)
 {
     assert(self != NULL && self->activeFiber == NULL);
 
-    if (List_IsEmpty(&self->readyFiberListHead)) {
+    if (!Scheduler_HasReadyFibers(self)) {
         return;
     }
 
@@ -213,11 +315,18 @@ Scheduler_Tick(struct Scheduler *self)
 
     if (setjmp(context) == 0) {
         self->context = &context;
-        struct Fiber *fiber = CONTAINER_OF(List_GetFront(&self->readyFiberListHead), struct Fiber
-                                           , listItem);
-        ListItem_Remove(&fiber->listItem);
-        Scheduler_SwitchToFiber(self, fiber);
+        Scheduler_SwitchToFiber(self, Scheduler_RemoveReadyFiber(self));
     } else {
+        if (self->detachCallback != NULL) {
+            void (*callback)(uintptr_t) = self->detachCallback;
+            self->detachCallback = NULL;
+            callback(self->detachData);
+
+            if (Scheduler_HasReadyFibers(self)) {
+                Scheduler_SwitchToFiber(self, Scheduler_RemoveReadyFiber(self));
+            }
+        }
+
         struct ListItem *fiberListItem = List_GetBack(&self->deadFiberListHead);
 
         if (fiberListItem == &self->deadFiberListHead) {
@@ -227,7 +336,7 @@ Scheduler_Tick(struct Scheduler *self)
         do {
             struct Fiber *fiber = CONTAINER_OF(fiberListItem, struct Fiber, listItem);
             fiberListItem = ListItem_GetPrev(fiberListItem);
-            Fiber_Free(fiber);
+            Fiber_Free(fiber, &self->fiberMemoryPool);
         } while (fiberListItem != &self->deadFiberListHead);
 
         List_Initialize(&self->deadFiberListHead);
@@ -235,6 +344,39 @@ Scheduler_Tick(struct Scheduler *self)
 }
 
 
+void
+Fiber_SwapContext(struct Fiber *self)
+{
+    assert(self != NULL && self->context != NULL);
+    jmp_buf *context1 = self->context;
+    jmp_buf context2;
+
+    if (setjmp(context2) != 0) {
+        return;
+    }
+
+    self->context = &context2;
+    longjmp(*context1, 1);
+}
+
+
+uint64_t
+Fiber_GetDeadline(const struct Fiber *self)
+{
+    assert(self != NULL);
+    return self->deadline;
+}
+
+
+void
+Fiber_SetDeadline(struct Fiber *self, uint64_t deadline)
+{
+    assert(self != NULL);
+    self->deadline = deadline;
+    self->hasMissedDeadline = false;
+}
+
+
 static NORETURN void
 Scheduler_SwitchToFiber(struct Scheduler *self, struct Fiber *fiber)
 {
@@ -286,22 +428,96 @@ Scheduler_SwitchTo(struct Scheduler *self)
 }
 
 
+static bool
+Scheduler_HasReadyFibers(const struct Scheduler *self)
+{
+    return !List_IsEmpty(&self->readyFiberListHead) || Heap_GetTop(&self->readyFiberHeap) != NULL;
+}
+
+
+static void
+Scheduler_InsertReadyFiber(struct Scheduler *self, struct Fiber *fiber, bool isFront)
+{
+    fiber->isReady = true;
+    ++self->readyFiberCount;
+
+    if (self->isEarliestDeadlineFirst && fiber->deadline != UINT64_MAX) {
+        fiber->sequenceNumber = isFront ? 0 : ++self->nextSequenceNumber;
+
+        if (Heap_InsertNode(&self->readyFiberHeap, &fiber->heapNode, FiberHeapNode_Compare)) {
+            fiber->isInReadyFiberHeap = true;
+            return;
+        }
+    }
+
+    fiber->isInReadyFiberHeap = false;
+
+    if (isFront) {
+        List_InsertFront(&self->readyFiberListHead, &fiber->listItem);
+    } else {
+        List_InsertBack(&self->readyFiberListHead, &fiber->listItem);
+    }
+}
+
+
+static struct Fiber *
+Scheduler_RemoveReadyFiber(struct Scheduler *self)
+{
+    struct HeapNode *fiberHeapNode = Heap_GetTop(&self->readyFiberHeap);
+    struct Fiber *fiber;
+
+    if (fiberHeapNode == NULL) {
+        fiber = CONTAINER_OF(List_GetFront(&self->readyFiberListHead), struct Fiber, listItem);
+        ListItem_Remove(&fiber->listItem);
+    } else {
+        fiber = CONTAINER_OF(fiberHeapNode, struct Fiber, heapNode);
+        Heap_RemoveNode(&self->readyFiberHeap, fiberHeapNode, FiberHeapNode_Compare);
+        fiber->isInReadyFiberHeap = false;
+
+        if (!fiber->hasMissedDeadline && fiber->deadline < Timer_GetTime()) {
+            fiber->hasMissedDeadline = true;
+            ++self->numberOfMissedDeadlines;
+        }
+    }
+
+    fiber->isReady = false;
+    --self->readyFiberCount;
+    return fiber;
+}
+
+
+static int
+FiberHeapNode_Compare(const struct HeapNode *self, const struct HeapNode *other)
+{
+    const struct Fiber *fiber1 = CONTAINER_OF(self, const struct Fiber, heapNode);
+    const struct Fiber *fiber2 = CONTAINER_OF(other, const struct Fiber, heapNode);
+    int delta = COMPARE(fiber1->deadline, fiber2->deadline);
+
+    if (delta != 0) {
+        return delta;
+    }
+
+    return COMPARE(fiber1->sequenceNumber, fiber2->sequenceNumber);
+}
+
+
 static struct Fiber *
-Fiber_Allocate(void)
+Fiber_Allocate(struct MemoryPool *memoryPool)
 {
-    char *region = malloc(FIBER_SIZE);
+    struct Fiber *self = MemoryPool_AllocateBlock(memoryPool);
 
-    if (region == NULL) {
+    if (self == NULL) {
         return NULL;
     }
 
-#if defined __i386__ || defined __x86_64__
-    struct Fiber *self = (struct Fiber *)(region + FIBER_SIZE - sizeof *self);
-    self->stack = region;
-    self->stackSize = FIBER_SIZE - sizeof *self;
-#else
-#error architecture not supported
-#endif
+    self->stack = malloc(FIBER_STACK_SIZE);
+
+    if (self->stack == NULL) {
+        MemoryPool_FreeBlock(memoryPool, self);
+        return NULL;
+    }
+
+    self->stackSize = FIBER_STACK_SIZE;
 #if defined USE_VALGRIND
     self->stackID = VALGRIND_STACK_REGISTER(self->stack, self->stack + self->stackSize);
 #endif
@@ -310,15 +526,11 @@ Fiber_Allocate(void)
 
 
 static void
-Fiber_Free(struct Fiber *self)
+Fiber_Free(struct Fiber *self, struct MemoryPool *memoryPool)
 {
 #if defined USE_VALGRIND
     VALGRIND_STACK_DEREGISTER(self->stackID);
 #endif
-#if defined __i386__ || defined __x86_64__
-    char *region = (char *)self + sizeof *self - FIBER_SIZE;
-#else
-#error architecture not supported
-#endif
-    free(region);
+    free(self->stack);
+    MemoryPool_FreeBlock(memoryPool, self);
 }
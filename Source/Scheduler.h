@@ -13,6 +13,8 @@
 #include <assert.h>
 
 #include "List.h"
+#include "Heap.h"
+#include "MemoryPool.h"
 #include "Noreturn.h"
 
 
@@ -21,28 +23,45 @@ struct Fiber;
 
 struct Scheduler
 {
+    struct MemoryPool fiberMemoryPool;
     jmp_buf *context;
     struct Fiber *activeFiber;
     struct ListItem readyFiberListHead;
+    struct Heap readyFiberHeap;
+    bool isEarliestDeadlineFirst;
+    uint64_t nextSequenceNumber;
+    int numberOfMissedDeadlines;
     struct ListItem deadFiberListHead;
     int fiberCount;
+    int readyFiberCount;
+    void (*detachCallback)(uintptr_t);
+    uintptr_t detachData;
 };
 
 
 static inline struct Fiber *Scheduler_GetCurrentFiber(const struct Scheduler *);
 static inline int Scheduler_GetFiberCount(const struct Scheduler *);
+static inline int Scheduler_GetReadyFiberCount(const struct Scheduler *);
+static inline int Scheduler_GetNumberOfMissedDeadlines(const struct Scheduler *);
 
 void Scheduler_Initialize(struct Scheduler *);
-void Scheduler_Finalize(const struct Scheduler *);
+void Scheduler_Finalize(struct Scheduler *);
+void Scheduler_SetEarliestDeadlineFirst(struct Scheduler *, bool);
 bool Scheduler_AddFiber(struct Scheduler *, void (*)(uintptr_t), uintptr_t);
 bool Scheduler_AddAndRunFiber(struct Scheduler *, void (*)(uintptr_t), uintptr_t);
 void Scheduler_YieldCurrentFiber(struct Scheduler *);
+bool Scheduler_YieldCurrentFiberTo(struct Scheduler *, struct Fiber *);
 void Scheduler_SuspendCurrentFiber(struct Scheduler *);
 void Scheduler_ResumeFiber(struct Scheduler *, struct Fiber *);
 void Scheduler_UnresumeFiber(struct Scheduler *, struct Fiber *);
 NORETURN void Scheduler_ExitCurrentFiber(struct Scheduler *);
+void Scheduler_DetachCurrentFiber(struct Scheduler *, void (*)(uintptr_t), uintptr_t);
 void Scheduler_Tick(struct Scheduler *);
 
+void Fiber_SwapContext(struct Fiber *);
+uint64_t Fiber_GetDeadline(const struct Fiber *);
+void Fiber_SetDeadline(struct Fiber *, uint64_t);
+
 
 static inline struct Fiber *
 Scheduler_GetCurrentFiber(const struct Scheduler *self)
@@ -58,3 +77,19 @@ Scheduler_GetFiberCount(const struct Scheduler *self)
     assert(self != NULL);
     return self->fiberCount;
 }
+
+
+static inline int
+Scheduler_GetReadyFiberCount(const struct Scheduler *self)
+{
+    assert(self != NULL);
+    return self->readyFiberCount;
+}
+
+
+static inline int
+Scheduler_GetNumberOfMissedDeadlines(const struct Scheduler *self)
+{
+    assert(self != NULL);
+    return self->numberOfMissedDeadlines;
+}
@@ -10,6 +10,8 @@
 
 #include "List.h"
 #include "Scheduler.h"
+#include "Timer.h"
+#include "Shutdown.h"
 #include "Utility.h"
 
 
@@ -17,10 +19,25 @@ struct SemaphoreWaiter
 {
     struct ListItem listItem;
     struct Fiber *fiber;
+    bool isResumed;
+    bool hasTimeout;
+    int errorNumber;
+    struct Timeout timeout;
+    struct ShutdownWatch shutdownWatch;
 };
 
 
+static bool WaitForSemaphore(struct ListItem *);
+static void WaitForSemaphoreCallback1(uintptr_t);
+static void WaitForSemaphoreCallback2(uintptr_t);
+static void CancelSemaphoreWaiter(struct SemaphoreWaiter *, int);
+static void ResumeSemaphoreWaiter(struct ListItem *);
+static void UnresumeSemaphoreWaiter(struct ListItem *);
+
+
 struct Scheduler Scheduler;
+struct Timer Timer;
+struct Shutdown Shutdown;
 
 
 bool
@@ -44,71 +61,163 @@ Semaphore_Initialize(struct Semaphore *self, int value, int minValue, int maxVal
 }
 
 
-void
+bool
 Semaphore_Down(struct Semaphore *self)
 {
     if (self == NULL) {
-        return;
+        return true;
     }
 
     if (self->value == self->minValue) {
-        struct SemaphoreWaiter waiter;
-        waiter.fiber = Scheduler_GetCurrentFiber(&Scheduler);
-        List_InsertBack(LIST_HEAD(self->downWaiterList), &waiter.listItem);
-        Scheduler_SuspendCurrentFiber(&Scheduler);
-        ListItem_Remove(&waiter.listItem);
+        if (!WaitForSemaphore(LIST_HEAD(self->downWaiterList))) {
+            return false;
+        }
 
         if (--self->value > self->minValue && !List_IsEmpty(LIST_HEAD(self->downWaiterList))) {
-            Scheduler_ResumeFiber(&Scheduler
-                                  , CONTAINER_OF(List_GetFront(LIST_HEAD(self->downWaiterList))
-                                                 , struct SemaphoreWaiter, listItem)->fiber);
+            ResumeSemaphoreWaiter(LIST_HEAD(self->downWaiterList));
         }
     } else {
         if (--self->value == self->minValue && !List_IsEmpty(LIST_HEAD(self->downWaiterList))) {
-            Scheduler_UnresumeFiber(&Scheduler
-                                    , CONTAINER_OF(List_GetFront(LIST_HEAD(self->downWaiterList))
-                                                   , struct SemaphoreWaiter, listItem)->fiber);
+            UnresumeSemaphoreWaiter(LIST_HEAD(self->downWaiterList));
         }
     }
 
     if (self->value == self->maxValue - 1 && !List_IsEmpty(LIST_HEAD(self->upWaiterList))) {
-        Scheduler_ResumeFiber(&Scheduler
-                              , CONTAINER_OF(List_GetFront(LIST_HEAD(self->upWaiterList))
-                                             , struct SemaphoreWaiter, listItem)->fiber);
+        ResumeSemaphoreWaiter(LIST_HEAD(self->upWaiterList));
     }
+
+    return true;
 }
 
 
-void
+bool
 Semaphore_Up(struct Semaphore *self)
 {
     if (self == NULL) {
-        return;
+        return true;
     }
 
     if (self->value == self->maxValue) {
-        struct SemaphoreWaiter waiter;
-        waiter.fiber = Scheduler_GetCurrentFiber(&Scheduler);
-        List_InsertBack(LIST_HEAD(self->upWaiterList), &waiter.listItem);
-        Scheduler_SuspendCurrentFiber(&Scheduler);
-        ListItem_Remove(&waiter.listItem);
+        if (!WaitForSemaphore(LIST_HEAD(self->upWaiterList))) {
+            return false;
+        }
 
         if (++self->value < self->maxValue && !List_IsEmpty(LIST_HEAD(self->upWaiterList))) {
-            Scheduler_ResumeFiber(&Scheduler
-                                  , CONTAINER_OF(List_GetFront(LIST_HEAD(self->upWaiterList))
-                                                 , struct SemaphoreWaiter, listItem)->fiber);
+            ResumeSemaphoreWaiter(LIST_HEAD(self->upWaiterList));
         }
     } else {
         if (++self->value == self->maxValue && !List_IsEmpty(LIST_HEAD(self->upWaiterList))) {
-            Scheduler_UnresumeFiber(&Scheduler
-                                    , CONTAINER_OF(List_GetFront(LIST_HEAD(self->upWaiterList))
-                                                   , struct SemaphoreWaiter, listItem)->fiber);
+            UnresumeSemaphoreWaiter(LIST_HEAD(self->upWaiterList));
         }
     }
 
     if (self->value == self->minValue + 1 && !List_IsEmpty(LIST_HEAD(self->downWaiterList))) {
-        Scheduler_ResumeFiber(&Scheduler
-                              , CONTAINER_OF(List_GetFront(LIST_HEAD(self->downWaiterList))
-                                             , struct SemaphoreWaiter, listItem)->fiber);
+        ResumeSemaphoreWaiter(LIST_HEAD(self->downWaiterList));
     }
+
+    return true;
+}
+
+
+static bool
+WaitForSemaphore(struct ListItem *waiterListHead)
+{
+    if (Shutdown_GetState(&Shutdown) == ShutdownExpired) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    struct SemaphoreWaiter waiter;
+    waiter.fiber = Scheduler_GetCurrentFiber(&Scheduler);
+    waiter.isResumed = false;
+    waiter.errorNumber = 0;
+    int timeout = Timer_ApplyDeadline(&Timer, -1, Fiber_GetDeadline(waiter.fiber));
+    waiter.hasTimeout = timeout >= 0;
+
+    if (waiter.hasTimeout) {
+        if (!Timer_SetTimeout(&Timer, &waiter.timeout, timeout, (uintptr_t)&waiter
+                              , WaitForSemaphoreCallback1)) {
+            return false;
+        }
+    }
+
+    List_InsertBack(waiterListHead, &waiter.listItem);
+    Shutdown_SetWatch(&Shutdown, &waiter.shutdownWatch, ShutdownExpired, (uintptr_t)&waiter
+                      , WaitForSemaphoreCallback2);
+    Scheduler_SuspendCurrentFiber(&Scheduler);
+
+    if (waiter.errorNumber != 0) {
+        errno = waiter.errorNumber;
+        return false;
+    }
+
+    if (waiter.hasTimeout) {
+        Timer_ClearTimeout(&Timer, &waiter.timeout);
+    }
+
+    Shutdown_ClearWatch(&Shutdown, &waiter.shutdownWatch);
+    ListItem_Remove(&waiter.listItem);
+    return true;
+}
+
+
+static void
+WaitForSemaphoreCallback1(uintptr_t argument)
+{
+    struct SemaphoreWaiter *waiter = (struct SemaphoreWaiter *)argument;
+    Shutdown_ClearWatch(&Shutdown, &waiter->shutdownWatch);
+    CancelSemaphoreWaiter(waiter, EINTR);
+}
+
+
+static void
+WaitForSemaphoreCallback2(uintptr_t argument)
+{
+    struct SemaphoreWaiter *waiter = (struct SemaphoreWaiter *)argument;
+
+    if (waiter->hasTimeout) {
+        Timer_ClearTimeout(&Timer, &waiter->timeout);
+    }
+
+    CancelSemaphoreWaiter(waiter, ECANCELED);
+}
+
+
+static void
+CancelSemaphoreWaiter(struct SemaphoreWaiter *waiter, int errorNumber)
+{
+    if (waiter->isResumed) {
+        struct ListItem *waiterListHead = ListItem_GetPrev(&waiter->listItem);
+        Scheduler_UnresumeFiber(&Scheduler, waiter->fiber);
+        ListItem_Remove(&waiter->listItem);
+
+        if (!List_IsEmpty(waiterListHead)) {
+            ResumeSemaphoreWaiter(waiterListHead);
+        }
+    } else {
+        ListItem_Remove(&waiter->listItem);
+    }
+
+    waiter->errorNumber = errorNumber;
+    Scheduler_ResumeFiber(&Scheduler, waiter->fiber);
+}
+
+
+static void
+ResumeSemaphoreWaiter(struct ListItem *waiterListHead)
+{
+    struct SemaphoreWaiter *waiter = CONTAINER_OF(List_GetFront(waiterListHead)
+                                                  , struct SemaphoreWaiter, listItem);
+    waiter->isResumed = true;
+    Scheduler_ResumeFiber(&Scheduler, waiter->fiber);
+}
+
+
+static void
+UnresumeSemaphoreWaiter(struct ListItem *waiterListHead)
+{
+    struct SemaphoreWaiter *waiter = CONTAINER_OF(List_GetFront(waiterListHead)
+                                                  , struct SemaphoreWaiter, listItem);
+    waiter->isResumed = false;
+    Scheduler_UnresumeFiber(&Scheduler, waiter->fiber);
 }
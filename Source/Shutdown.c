@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "Shutdown.h"
+
+#include "Utility.h"
+
+
+static void Shutdown_FireWatches(struct Shutdown *, struct ListItem *);
+
+
+void
+Shutdown_Initialize(struct Shutdown *self)
+{
+    assert(self != NULL);
+    self->state = ShutdownNone;
+    List_Initialize(&self->watchListHeads[0]);
+    List_Initialize(&self->watchListHeads[1]);
+}
+
+
+void
+Shutdown_SetWatch(struct Shutdown *self, struct ShutdownWatch *watch, enum ShutdownState state
+                  , uintptr_t data, void (*callback)(uintptr_t))
+{
+    assert(self != NULL);
+    assert(watch != NULL);
+    assert(state == ShutdownDraining || state == ShutdownExpired);
+    assert(self->state < state);
+    assert(callback != NULL);
+    watch->data = data;
+    watch->callback = callback;
+    List_InsertBack(&self->watchListHeads[state - ShutdownDraining], &watch->listItem);
+}
+
+
+void
+Shutdown_ClearWatch(struct Shutdown *self, const struct ShutdownWatch *watch)
+{
+    assert(self != NULL);
+    assert(watch != NULL);
+    (void)self;
+    ListItem_Remove(&watch->listItem);
+}
+
+
+void
+Shutdown_SetState(struct Shutdown *self, enum ShutdownState state)
+{
+    assert(self != NULL);
+    assert(state == ShutdownDraining || state == ShutdownExpired);
+
+    if (self->state >= state) {
+        return;
+    }
+
+    self->state = state;
+    Shutdown_FireWatches(self, &self->watchListHeads[0]);
+
+    if (state == ShutdownExpired) {
+        Shutdown_FireWatches(self, &self->watchListHeads[1]);
+    }
+}
+
+
+static void
+Shutdown_FireWatches(struct Shutdown *self, struct ListItem *watchListHead)
+{
+    (void)self;
+
+    while (!List_IsEmpty(watchListHead)) {
+        struct ShutdownWatch *watch = CONTAINER_OF(List_GetFront(watchListHead)
+                                                   , struct ShutdownWatch, listItem);
+        ListItem_Remove(&watch->listItem);
+        watch->callback(watch->data);
+    }
+}
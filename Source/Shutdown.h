@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "List.h"
+
+
+enum ShutdownState
+{
+    ShutdownNone,
+    ShutdownDraining,
+    ShutdownExpired
+};
+
+
+struct Shutdown
+{
+    enum ShutdownState state;
+    struct ListItem watchListHeads[2];
+};
+
+
+struct ShutdownWatch
+{
+    struct ListItem listItem;
+    uintptr_t data;
+    void (*callback)(uintptr_t);
+};
+
+
+static inline enum ShutdownState Shutdown_GetState(const struct Shutdown *);
+
+void Shutdown_Initialize(struct Shutdown *);
+void Shutdown_SetWatch(struct Shutdown *, struct ShutdownWatch *, enum ShutdownState, uintptr_t
+                       , void (*)(uintptr_t));
+void Shutdown_ClearWatch(struct Shutdown *, const struct ShutdownWatch *);
+void Shutdown_SetState(struct Shutdown *, enum ShutdownState);
+
+
+static inline enum ShutdownState
+Shutdown_GetState(const struct Shutdown *self)
+{
+    assert(self != NULL);
+    return self->state;
+}
@@ -10,6 +10,7 @@
 #include <time.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 
 #include "Utility.h"
 #include "Async.h"
@@ -67,6 +68,15 @@ Timer_ClearTimeout(struct Timer *self, const struct Timeout *timeout)
 }
 
 
+bool
+Timer_HasTimeout(const struct Timer *self, const struct Timeout *timeout)
+{
+    assert(self != NULL);
+    assert(timeout != NULL);
+    return Heap_HasNode(&self->timeoutHeap, &timeout->heapNode);
+}
+
+
 int
 Timer_CalculateWaitTime(const struct Timer *self)
 {
@@ -93,6 +103,35 @@ Timer_CalculateWaitTime(const struct Timer *self)
 }
 
 
+int
+Timer_ApplyDeadline(const struct Timer *self, int delay, uint64_t deadline)
+{
+    assert(self != NULL);
+    (void)self;
+
+    if (deadline == UINT64_MAX) {
+        return delay;
+    }
+
+    uint64_t now = GetTime();
+    int maxDelay;
+
+    if (deadline <= now) {
+        maxDelay = 0;
+    } else if (deadline - now > INT_MAX) {
+        maxDelay = INT_MAX;
+    } else {
+        maxDelay = deadline - now;
+    }
+
+    if (delay < 0 || delay > maxDelay) {
+        return maxDelay;
+    }
+
+    return delay;
+}
+
+
 bool
 Timer_Tick(struct Timer *self, struct Async *async)
 {
@@ -125,6 +164,20 @@ Timer_Tick(struct Timer *self, struct Async *async)
 }
 
 
+uint64_t
+Timer_GetTime(void)
+{
+    return GetTime();
+}
+
+
+uint64_t
+Timer_GetDeadline(int timeout)
+{
+    return timeout < 0 ? UINT64_MAX : GetTime() + timeout;
+}
+
+
 static int
 TimeoutHeapNode_Compare(const struct HeapNode *self, const struct HeapNode *other)
 {
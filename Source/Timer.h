@@ -34,5 +34,10 @@ void Timer_Initialize(struct Timer *);
 void Timer_Finalize(struct Timer *);
 bool Timer_SetTimeout(struct Timer *, struct Timeout *, int, uintptr_t, void (*)(uintptr_t));
 void Timer_ClearTimeout(struct Timer *, const struct Timeout *);
+bool Timer_HasTimeout(const struct Timer *, const struct Timeout *);
 int Timer_CalculateWaitTime(const struct Timer *);
+int Timer_ApplyDeadline(const struct Timer *, int, uint64_t);
 bool Timer_Tick(struct Timer *, struct Async *);
+
+uint64_t Timer_GetTime(void);
+uint64_t Timer_GetDeadline(int);
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "WaitTable.h"
+
+#include <stddef.h>
+#include <assert.h>
+
+#include "Utility.h"
+
+
+static struct ListItem *WaitTable_LocateBucket(struct WaitTable *, const void *);
+
+
+void
+WaitTable_Initialize(struct WaitTable *self)
+{
+    assert(self != NULL);
+    int i;
+
+    for (i = 0; i < __WAIT_TABLE_SIZE; ++i) {
+        List_Initialize(&self->bucketListHeads[i]);
+    }
+}
+
+
+void
+WaitTable_AddWaiter(struct WaitTable *self, struct AddressWaiter *waiter, const void *address
+                    , uintptr_t data, void (*callback)(uintptr_t))
+{
+    assert(self != NULL);
+    assert(waiter != NULL);
+    assert(callback != NULL);
+    waiter->address = address;
+    waiter->data = data;
+    waiter->callback = callback;
+    List_InsertBack(WaitTable_LocateBucket(self, address), &waiter->listItem);
+}
+
+
+void
+WaitTable_RemoveWaiter(struct WaitTable *self, const struct AddressWaiter *waiter)
+{
+    assert(self != NULL);
+    assert(waiter != NULL);
+    (void)self;
+    ListItem_Remove(&waiter->listItem);
+}
+
+
+int
+WaitTable_WakeWaiters(struct WaitTable *self, const void *address, int numberOfWaiters)
+{
+    assert(self != NULL);
+    struct ListItem *bucketListHead = WaitTable_LocateBucket(self, address);
+    struct ListItem *waiterListItem;
+    struct ListItem *temp;
+    int n = 0;
+
+    FOR_EACH_LIST_ITEM_SAFE(waiterListItem, temp, bucketListHead) {
+        if (n == numberOfWaiters) {
+            break;
+        }
+
+        struct AddressWaiter *waiter = CONTAINER_OF(waiterListItem, struct AddressWaiter
+                                                    , listItem);
+
+        if (waiter->address != address) {
+            continue;
+        }
+
+        ListItem_Remove(&waiter->listItem);
+        waiter->callback(waiter->data);
+        ++n;
+    }
+
+    return n;
+}
+
+
+static struct ListItem *
+WaitTable_LocateBucket(struct WaitTable *self, const void *address)
+{
+    uintptr_t hash = (uintptr_t)address * UINT32_C(2654435761);
+    return &self->bucketListHeads[(hash >> 16) % (unsigned int)__WAIT_TABLE_SIZE];
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include "List.h"
+
+
+#define __WAIT_TABLE_SIZE 256
+
+
+struct WaitTable
+{
+    struct ListItem bucketListHeads[__WAIT_TABLE_SIZE];
+};
+
+
+struct AddressWaiter
+{
+    struct ListItem listItem;
+    const void *address;
+    uintptr_t data;
+    void (*callback)(uintptr_t);
+};
+
+
+void WaitTable_Initialize(struct WaitTable *);
+void WaitTable_AddWaiter(struct WaitTable *, struct AddressWaiter *, const void *, uintptr_t
+                         , void (*)(uintptr_t));
+void WaitTable_RemoveWaiter(struct WaitTable *, const struct AddressWaiter *);
+int WaitTable_WakeWaiters(struct WaitTable *, const void *, int);
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "ZeroCopy.h"
+
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include <stddef.h>
+#include <errno.h>
+
+#include "IO.h"
+#include "Vector.h"
+#include "Utility.h"
+
+
+struct ZeroCopy
+{
+    int fd;
+    uint32_t nextID;
+    uint32_t completedID;
+    struct Vector rangeVector;
+    int numberOfRanges;
+};
+
+
+struct ZeroCopyRange
+{
+    uint32_t firstID;
+    uint32_t lastID;
+};
+
+
+static void ZeroCopy_ReadNotifications(struct ZeroCopy *);
+static bool ZeroCopy_ReadNotification(struct ZeroCopy *, int);
+static bool ZeroCopy_AddRange(struct ZeroCopy *, uint32_t, uint32_t);
+static void ZeroCopy_MergeRanges(struct ZeroCopy *);
+
+
+bool
+ZeroCopySender_Initialize(struct ZeroCopySender *self, int fd)
+{
+    STATIC_ASSERT(sizeof(struct ZeroCopy) <= sizeof(struct ZeroCopySender));
+
+    if (self == NULL || fd < 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int optionValue = 1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &optionValue, sizeof optionValue) < 0) {
+        return false;
+    }
+
+    struct ZeroCopy *zeroCopy = (struct ZeroCopy *)self;
+    zeroCopy->fd = fd;
+    zeroCopy->nextID = 0;
+    zeroCopy->completedID = 0;
+    Vector_Initialize(&zeroCopy->rangeVector, sizeof(struct ZeroCopyRange));
+    zeroCopy->numberOfRanges = 0;
+    return true;
+}
+
+
+void
+ZeroCopySender_Finalize(struct ZeroCopySender *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    Vector_Finalize(&((struct ZeroCopy *)self)->rangeVector);
+}
+
+
+ssize_t
+ZeroCopySender_Send(struct ZeroCopySender *self, const void *data, size_t dataSize, int flags
+                    , uint32_t *id, int timeout)
+{
+    struct iovec vector = {.iov_base = (void *)data, .iov_len = dataSize};
+    struct msghdr message = {.msg_iov = &vector, .msg_iovlen = 1};
+    return ZeroCopySender_SendMsg(self, &message, flags, id, timeout);
+}
+
+
+ssize_t
+ZeroCopySender_SendMsg(struct ZeroCopySender *self, const struct msghdr *message, int flags
+                       , uint32_t *id, int timeout)
+{
+    if (self == NULL || id == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct ZeroCopy *zeroCopy = (struct ZeroCopy *)self;
+    ssize_t numberOfBytes = SendMsg(zeroCopy->fd, message, flags | MSG_ZEROCOPY, timeout);
+
+    if (numberOfBytes >= 1) {
+        *id = zeroCopy->nextID++;
+    }
+
+    return numberOfBytes;
+}
+
+
+bool
+ZeroCopySender_IsCompleted(struct ZeroCopySender *self, uint32_t id)
+{
+    if (self == NULL) {
+        return false;
+    }
+
+    struct ZeroCopy *zeroCopy = (struct ZeroCopy *)self;
+    ZeroCopy_ReadNotifications(zeroCopy);
+    return (int32_t)(id - zeroCopy->completedID) < 0;
+}
+
+
+bool
+ZeroCopySender_WaitForCompletion(struct ZeroCopySender *self, uint32_t id, int timeout)
+{
+    if (self == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    struct ZeroCopy *zeroCopy = (struct ZeroCopy *)self;
+
+    if ((int32_t)(id - zeroCopy->nextID) >= 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    ZeroCopy_ReadNotifications(zeroCopy);
+
+    while ((int32_t)(id - zeroCopy->completedID) >= 0) {
+        if (timeout == 0) {
+            errno = EINTR;
+            return false;
+        }
+
+        if (!ZeroCopy_ReadNotification(zeroCopy, timeout)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void
+ZeroCopy_ReadNotifications(struct ZeroCopy *self)
+{
+    while (ZeroCopy_ReadNotification(self, 0)) {
+        continue;
+    }
+}
+
+
+static bool
+ZeroCopy_ReadNotification(struct ZeroCopy *self, int timeout)
+{
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+    } control;
+
+    struct msghdr message = {
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof control.buffer
+    };
+
+    ssize_t numberOfBytes;
+
+    if (timeout == 0) {
+        do {
+            numberOfBytes = recvmsg(self->fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT);
+        } while (numberOfBytes < 0 && errno == EINTR);
+    } else {
+        numberOfBytes = RecvMsg(self->fd, &message, MSG_ERRQUEUE, timeout);
+    }
+
+    if (numberOfBytes < 0) {
+        return false;
+    }
+
+    struct cmsghdr *controlMessage;
+
+    for (controlMessage = CMSG_FIRSTHDR(&message); controlMessage != NULL
+         ; controlMessage = CMSG_NXTHDR(&message, controlMessage)) {
+        if (!(controlMessage->cmsg_level == SOL_IP && controlMessage->cmsg_type == IP_RECVERR)
+            && !(controlMessage->cmsg_level == SOL_IPV6
+                 && controlMessage->cmsg_type == IPV6_RECVERR)) {
+            continue;
+        }
+
+        const struct sock_extended_err *error = (const void *)CMSG_DATA(controlMessage);
+
+        if (error->ee_errno == 0 && error->ee_origin == SO_EE_ORIGIN_ZEROCOPY
+            && !ZeroCopy_AddRange(self, error->ee_info, error->ee_data)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static bool
+ZeroCopy_AddRange(struct ZeroCopy *self, uint32_t firstID, uint32_t lastID)
+{
+    if ((int32_t)(firstID - self->completedID) > 0) {
+        if (self->numberOfRanges == Vector_GetLength(&self->rangeVector)
+            && !Vector_SetLength(&self->rangeVector, self->numberOfRanges + 1, false)) {
+            return false;
+        }
+
+        struct ZeroCopyRange *ranges = Vector_GetElements(&self->rangeVector);
+        ranges[self->numberOfRanges++] = (struct ZeroCopyRange){firstID, lastID};
+        return true;
+    }
+
+    if ((int32_t)(lastID + 1 - self->completedID) > 0) {
+        self->completedID = lastID + 1;
+        ZeroCopy_MergeRanges(self);
+    }
+
+    return true;
+}
+
+
+static void
+ZeroCopy_MergeRanges(struct ZeroCopy *self)
+{
+    struct ZeroCopyRange *ranges = Vector_GetElements(&self->rangeVector);
+    int i = 0;
+
+    while (i < self->numberOfRanges) {
+        if ((int32_t)(ranges[i].firstID - self->completedID) > 0) {
+            ++i;
+            continue;
+        }
+
+        if ((int32_t)(ranges[i].lastID + 1 - self->completedID) > 0) {
+            self->completedID = ranges[i].lastID + 1;
+        }
+
+        ranges[i] = ranges[--self->numberOfRanges];
+        i = 0;
+    }
+}